@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <sstream>
+#include "BranchPredictor.hpp"
+
+namespace {
+enum BTBFlags : uint8_t {
+    VALID = 1 << 0,
+    CONDITIONAL = 1 << 1
+};
+
+// Always fetch the next instruction
+class NotTakenPredictor : public BranchPredictor {
+public:
+    explicit NotTakenPredictor(const PredictorConfig& config) : BranchPredictor(config) {}
+protected:
+    bool predictTaken(uint32_t) override { return false; }
+    void train(uint32_t, bool) override {}
+    void reset() override {}
+};
+
+// A conditional branch is predicted taken while it has a BTB entry, which
+// it loses the first time it falls through
+class BTBPredictor : public BranchPredictor {
+public:
+    explicit BTBPredictor(const PredictorConfig& config) : BranchPredictor(config) {}
+protected:
+    bool predictTaken(uint32_t) override { return true; }
+    void train(uint32_t pc, bool taken) override {
+        if (!taken) btb.remove(pc);
+    }
+    void reset() override {}
+};
+
+// Table of 2-bit saturating counters (0-1 not taken, 2-3 taken); gshare
+// indexes it with the pc xor the global history of branch outcomes
+class CounterPredictor : public BranchPredictor {
+public:
+    CounterPredictor(const PredictorConfig& config, bool useHistory)
+        : BranchPredictor(config),
+          useHistory(useHistory),
+          counters(size_t(1) << config.counterBits, 1),
+          counterMask((1u << config.counterBits) - 1),
+          historyMask(useHistory ? (1u << config.historyBits) - 1 : 0) {}
+protected:
+    bool predictTaken(uint32_t pc) override {
+        return counters[index(pc)] >= 2;
+    }
+    void train(uint32_t pc, bool taken) override {
+        uint8_t& counter = counters[index(pc)];
+        if (taken && counter < 3) counter++;
+        if (!taken && counter > 0) counter--;
+        if (useHistory) {
+            history = ((history << 1) | (taken ? 1 : 0)) & historyMask;
+        }
+    }
+    void reset() override {
+        fill(counters.begin(), counters.end(), 1);
+        history = 0;
+    }
+    void saveTables(CheckpointWriter& out) const override {
+        out.writeVector(counters);
+        out.write(history);
+    }
+    bool restoreTables(CheckpointReader& in) override {
+        return in.readVector(counters) && in.read(history) && (history & ~historyMask) == 0;
+    }
+private:
+    uint32_t index(uint32_t pc) const {
+        return ((pc >> 2) ^ history) & counterMask;
+    }
+
+    bool useHistory;
+    vector<uint8_t> counters;
+    uint32_t counterMask;
+    uint32_t historyMask;
+    uint32_t history = 0;
+};
+} // namespace
+
+bool PredictorConfig::parse(const string& text, PredictorConfig& config) {
+    vector<string> fields;
+    istringstream in(text);
+    string field;
+    while (getline(in, field, ':')) {
+        fields.push_back(field);
+    }
+    if (fields.empty()) return false;
+    vector<uint32_t*> numbers;
+    if (fields[0] == "not-taken") {
+        config.kind = NOT_TAKEN;
+    } else if (fields[0] == "btb") {
+        config.kind = BTB;
+        numbers = {&config.btbEntries};
+    } else if (fields[0] == "bimodal") {
+        config.kind = BIMODAL;
+        numbers = {&config.counterBits, &config.btbEntries};
+    } else if (fields[0] == "gshare") {
+        config.kind = GSHARE;
+        numbers = {&config.counterBits, &config.historyBits, &config.btbEntries};
+    } else {
+        return false;
+    }
+    if (fields.size() - 1 > numbers.size()) return false;
+    try {
+        for (size_t i = 1; i < fields.size(); i++) {
+            *numbers[i - 1] = stoul(fields[i]);
+        }
+    } catch (const exception&) {
+        return false;
+    }
+    bool btbPowerOfTwo = config.btbEntries != 0 && (config.btbEntries & (config.btbEntries - 1)) == 0;
+    return btbPowerOfTwo && config.counterBits >= 1 && config.counterBits <= 24 && config.historyBits <= 24;
+}
+
+string PredictorConfig::describe() const {
+    ostringstream out;
+    switch (kind) {
+    case NONE: out << "none"; break;
+    case NOT_TAKEN: out << "not-taken"; break;
+    case BTB: out << "btb:" << btbEntries; break;
+    case BIMODAL: out << "bimodal:" << counterBits << ":" << btbEntries; break;
+    case GSHARE: out << "gshare:" << counterBits << ":" << historyBits << ":" << btbEntries; break;
+    }
+    return out.str();
+}
+
+BranchTargetBuffer::BranchTargetBuffer(uint32_t entries)
+    : mask(entries ? entries - 1 : 0), tags(entries, 0), targets(entries, 0), flags(entries, 0) {}
+
+bool BranchTargetBuffer::lookup(uint32_t pc, uint32_t& target, bool& conditional) const {
+    if (flags.empty()) return false;
+    uint32_t entry = (pc >> 2) & mask;
+    if (!(flags[entry] & VALID) || tags[entry] != pc) return false;
+    target = targets[entry];
+    conditional = flags[entry] & CONDITIONAL;
+    return true;
+}
+
+void BranchTargetBuffer::insert(uint32_t pc, uint32_t target, bool conditional) {
+    if (flags.empty()) return;
+    uint32_t entry = (pc >> 2) & mask;
+    tags[entry] = pc;
+    targets[entry] = target;
+    flags[entry] = VALID | (conditional ? CONDITIONAL : 0);
+}
+
+void BranchTargetBuffer::remove(uint32_t pc) {
+    if (flags.empty()) return;
+    uint32_t entry = (pc >> 2) & mask;
+    if (tags[entry] == pc) flags[entry] = 0;
+}
+
+void BranchTargetBuffer::clear() {
+    fill(flags.begin(), flags.end(), 0);
+}
+
+void BranchTargetBuffer::save(CheckpointWriter& out) const {
+    out.writeVector(tags);
+    out.writeVector(targets);
+    out.writeVector(flags);
+}
+
+bool BranchTargetBuffer::restore(CheckpointReader& in) {
+    return in.readVector(tags) && in.readVector(targets) && in.readVector(flags);
+}
+
+BranchPredictor::BranchPredictor(const PredictorConfig& config)
+    : config(config), btb(config.kind == PredictorConfig::NOT_TAKEN ? 0 : config.btbEntries) {}
+
+unique_ptr<BranchPredictor> BranchPredictor::create(const PredictorConfig& config) {
+    switch (config.kind) {
+    case PredictorConfig::NOT_TAKEN: return unique_ptr<BranchPredictor>(new NotTakenPredictor(config));
+    case PredictorConfig::BTB: return unique_ptr<BranchPredictor>(new BTBPredictor(config));
+    case PredictorConfig::BIMODAL: return unique_ptr<BranchPredictor>(new CounterPredictor(config, false));
+    case PredictorConfig::GSHARE: return unique_ptr<BranchPredictor>(new CounterPredictor(config, true));
+    default: return nullptr;
+    }
+}
+
+uint32_t BranchPredictor::predictNext(uint32_t pc) {
+    uint32_t target;
+    bool conditional;
+    if (btb.lookup(pc, target, conditional) && (!conditional || predictTaken(pc))) {
+        return target;
+    }
+    return pc + 4;
+}
+
+void BranchPredictor::update(uint32_t pc, bool conditional, bool taken, uint32_t target) {
+    if (taken) {
+        btb.insert(pc, target, conditional);
+    }
+    if (conditional) {
+        train(pc, taken);
+    }
+}
+
+void BranchPredictor::clear() {
+    btb.clear();
+    reset();
+}
+
+void BranchPredictor::save(CheckpointWriter& out) const {
+    btb.save(out);
+    saveTables(out);
+}
+
+bool BranchPredictor::restore(CheckpointReader& in) {
+    return btb.restore(in) && restoreTables(in);
+}
@@ -0,0 +1,86 @@
+#ifndef BRANCH_PREDICTOR_HPP
+#define BRANCH_PREDICTOR_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Checkpoint.hpp"
+
+using namespace std;
+
+// Predictor used by IF, e.g. "gshare:12:10:64"
+//   not-taken                        always fetch pc + 4
+//   btb[:entries]                    taken whenever the BTB knows the pc
+//   bimodal[:bits[:entries]]         2-bit counters indexed by pc, plus a BTB
+//   gshare[:bits[:history[:entries]]] 2-bit counters indexed by pc ^ global history
+struct PredictorConfig {
+    enum Kind { NONE, NOT_TAKEN, BTB, BIMODAL, GSHARE };
+
+    Kind kind = NONE;
+    uint32_t counterBits = 10;  // log2 of the number of 2-bit counters
+    uint32_t historyBits = 10;  // gshare global history length
+    uint32_t btbEntries = 64;   // Direct-mapped branch target buffer
+
+    // Parse the string form; returns false on malformed values
+    static bool parse(const string& text, PredictorConfig& config);
+    string describe() const;
+};
+
+// Direct-mapped branch target buffer: remembers the target of the control
+// transfers that were taken, and whether they are conditional.
+class BranchTargetBuffer {
+public:
+    explicit BranchTargetBuffer(uint32_t entries);
+    // True (setting target/conditional) if pc has an entry
+    bool lookup(uint32_t pc, uint32_t& target, bool& conditional) const;
+    void insert(uint32_t pc, uint32_t target, bool conditional);
+    void remove(uint32_t pc);
+    void clear();
+    void save(CheckpointWriter& out) const;
+    bool restore(CheckpointReader& in);
+
+private:
+    uint32_t mask;
+    vector<uint32_t> tags;    // pc of the entry
+    vector<uint32_t> targets;
+    vector<uint8_t> flags;    // VALID | CONDITIONAL
+};
+
+// Next-fetch-address prediction in IF. The BTB identifies control transfers
+// and supplies their targets; a derived class decides the direction of the
+// conditional ones. ID reports every resolved transfer through update().
+class BranchPredictor {
+public:
+    virtual ~BranchPredictor() = default;
+
+    // nullptr for PredictorConfig::NONE
+    static unique_ptr<BranchPredictor> create(const PredictorConfig& config);
+
+    // Address to fetch after the instruction at pc
+    uint32_t predictNext(uint32_t pc);
+    // Outcome of the branch or jump at pc, resolved in ID
+    void update(uint32_t pc, bool conditional, bool taken, uint32_t target);
+    // Forget everything learned
+    void clear();
+    // Everything learned, for a predictor of the same configuration
+    void save(CheckpointWriter& out) const;
+    bool restore(CheckpointReader& in);
+
+    const PredictorConfig& getConfig() const { return config; }
+
+protected:
+    explicit BranchPredictor(const PredictorConfig& config);
+    // Direction of the conditional branch at pc, and its training
+    virtual bool predictTaken(uint32_t pc) = 0;
+    virtual void train(uint32_t pc, bool taken) = 0;
+    virtual void reset() = 0;
+    // State of the direction predictor beyond the BTB
+    virtual void saveTables(CheckpointWriter&) const {}
+    virtual bool restoreTables(CheckpointReader&) { return true; }
+
+    PredictorConfig config;
+    BranchTargetBuffer btb;
+};
+
+#endif // BRANCH_PREDICTOR_HPP
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <sstream>
+#include "Cache.hpp"
+
+namespace {
+bool isPowerOfTwo(uint32_t value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+// Number of bits needed to index value entries (value is a power of two)
+uint32_t indexBits(uint32_t value) {
+    uint32_t bits = 0;
+    while ((1u << bits) < value) bits++;
+    return bits;
+}
+} // namespace
+
+bool CacheConfig::parse(const string& text, CacheConfig& config) {
+    vector<string> fields;
+    istringstream in(text);
+    string field;
+    while (getline(in, field, ':')) {
+        fields.push_back(field);
+    }
+    if (fields.size() < 3) return false;
+    try {
+        config.size = stoul(fields[0]);
+        config.ways = stoul(fields[1]);
+        config.lineSize = stoul(fields[2]);
+        for (size_t i = 3; i < fields.size(); i++) {
+            if (fields[i] == "lru") {
+                config.replacement = LRU;
+            } else if (fields[i] == "plru") {
+                config.replacement = PLRU;
+            } else if (fields[i] == "wb") {
+                config.writePolicy = WRITE_BACK;
+            } else if (fields[i] == "wt") {
+                config.writePolicy = WRITE_THROUGH;
+            } else {
+                config.missCycles = stoul(fields[i]);
+            }
+        }
+    } catch (const exception&) {
+        return false;
+    }
+    if (!isPowerOfTwo(config.lineSize) || config.lineSize < 4 || config.ways == 0) return false;
+    if (config.size % (config.ways * config.lineSize) != 0) return false;
+    if (!isPowerOfTwo(config.size / (config.ways * config.lineSize))) return false;
+    // The PLRU tree of a set lives in one 32-bit word
+    if (config.replacement == PLRU && (!isPowerOfTwo(config.ways) || config.ways > 32)) return false;
+    return true;
+}
+
+string CacheConfig::describe() const {
+    ostringstream out;
+    out << size << ":" << ways << ":" << lineSize << ":" << (replacement == LRU ? "lru" : "plru") << ":"
+        << (writePolicy == WRITE_BACK ? "wb" : "wt") << ":" << missCycles;
+    return out.str();
+}
+
+Cache::Cache(const CacheConfig& config)
+    : config(config),
+      sets(config.size / (config.ways * config.lineSize)),
+      offsetBits(indexBits(config.lineSize)),
+      setBits(indexBits(sets)),
+      setMask(sets - 1),
+      tags(sets * config.ways, 0),
+      state(sets * config.ways, 0),
+      lastUse(config.replacement == CacheConfig::LRU ? sets * config.ways : 0, 0),
+      plru(config.replacement == CacheConfig::PLRU ? sets : 0, 0) {}
+
+void Cache::clear() {
+    fill(state.begin(), state.end(), 0);
+    fill(lastUse.begin(), lastUse.end(), 0);
+    fill(plru.begin(), plru.end(), 0);
+    clock = 0;
+    reads = writes = readMisses = writeMisses = writebacks = 0;
+}
+
+void Cache::save(CheckpointWriter& out) const {
+    out.writeVector(tags);
+    out.writeVector(state);
+    out.writeVector(lastUse);
+    out.writeVector(plru);
+    out.write(clock);
+}
+
+bool Cache::restore(CheckpointReader& in) {
+    clear();
+    return in.readVector(tags) && in.readVector(state) && in.readVector(lastUse) &&
+        in.readVector(plru) && in.read(clock);
+}
+
+uint32_t Cache::access(uint32_t address, bool write) {
+    uint32_t lineNumber = address >> offsetBits;
+    uint32_t set = lineNumber & setMask;
+    uint32_t tag = lineNumber >> setBits;
+    uint32_t base = set * config.ways;
+    (write ? writes : reads)++;
+
+    for (uint32_t way = 0; way < config.ways; way++) {
+        if ((state[base + way] & VALID) && tags[base + way] == tag) {
+            if (write && config.writePolicy == CacheConfig::WRITE_BACK) {
+                state[base + way] |= DIRTY;
+            }
+            touch(set, way);
+            return 0;
+        }
+    }
+
+    (write ? writeMisses : readMisses)++;
+    if (write && config.writePolicy == CacheConfig::WRITE_THROUGH) {
+        return 0; // Not allocated; the write buffer absorbs the store
+    }
+    uint32_t way = victim(set);
+    if ((state[base + way] & (VALID | DIRTY)) == (VALID | DIRTY)) {
+        writebacks++; // Drained through the write buffer while the fill proceeds
+    }
+    tags[base + way] = tag;
+    state[base + way] = VALID | (write ? DIRTY : 0);
+    touch(set, way);
+    return config.missCycles;
+}
+
+uint32_t Cache::victim(uint32_t set) const {
+    uint32_t base = set * config.ways;
+    for (uint32_t way = 0; way < config.ways; way++) {
+        if (!(state[base + way] & VALID)) return way;
+    }
+    if (config.replacement == CacheConfig::PLRU) {
+        // Follow the tree bits from the root (node 1) down to a leaf
+        uint32_t node = 1;
+        while (node < config.ways) {
+            node = 2 * node + ((plru[set] >> node) & 1);
+        }
+        return node - config.ways;
+    }
+    uint32_t oldest = 0;
+    for (uint32_t way = 1; way < config.ways; way++) {
+        if (lastUse[base + way] < lastUse[base + oldest]) oldest = way;
+    }
+    return oldest;
+}
+
+void Cache::touch(uint32_t set, uint32_t way) {
+    if (config.replacement == CacheConfig::PLRU) {
+        // Point every node on the path away from the way just used
+        for (uint32_t node = way + config.ways; node > 1; node /= 2) {
+            uint32_t parent = node / 2;
+            uint32_t awayFromNode = (node & 1) ? 0 : 1;
+            plru[set] = (plru[set] & ~(1u << parent)) | (awayFromNode << parent);
+        }
+        return;
+    }
+    lastUse[set * config.ways + way] = ++clock;
+}
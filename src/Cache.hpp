@@ -0,0 +1,82 @@
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Checkpoint.hpp"
+
+using namespace std;
+
+// Geometry and policies of a cache, e.g. "4096:2:32:lru:wb:10"
+// (size:ways:line[:lru|plru][:wb|wt][:miss cycles])
+struct CacheConfig {
+    enum Replacement { LRU, PLRU };
+    enum WritePolicy {
+        WRITE_BACK,   // Write-allocate; dirty lines are written back on eviction
+        WRITE_THROUGH // No write-allocate; every store goes to memory through a write buffer
+    };
+
+    uint32_t size = 4096;     // Bytes
+    uint32_t ways = 2;
+    uint32_t lineSize = 32;   // Bytes
+    Replacement replacement = LRU;
+    WritePolicy writePolicy = WRITE_BACK;
+    uint32_t missCycles = 10; // Extra cycles an access waits for a line fill
+
+    // Parse the string form; returns false (leaving config unspecified) on
+    // malformed or inconsistent values
+    static bool parse(const string& text, CacheConfig& config);
+    string describe() const;
+};
+
+// Tag-only timing model of a set-associative cache: the data always lives in
+// DataMemory and the cache only decides how long an access takes. The tags,
+// state and replacement information are kept in flat arrays indexed by
+// set * ways + way, so a lookup touches one or two cache lines of the host.
+class Cache {
+public:
+    explicit Cache(const CacheConfig& config);
+
+    // Look up the line holding address, updating tags and replacement state;
+    // returns the extra cycles the access has to wait (0 on a hit)
+    uint32_t access(uint32_t address, bool write);
+    // Invalidate every line and clear the counters
+    void clear();
+    // Tags, line states and replacement information (not the counters); a
+    // cache only restores what a cache of the same configuration saved, and
+    // starts with cleared counters
+    void save(CheckpointWriter& out) const;
+    bool restore(CheckpointReader& in);
+
+    const CacheConfig& getConfig() const { return config; }
+
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    uint64_t readMisses = 0;
+    uint64_t writeMisses = 0;
+    uint64_t writebacks = 0; // Dirty lines evicted (write-back only)
+
+private:
+    enum LineState : uint8_t {
+        VALID = 1 << 0,
+        DIRTY = 1 << 1
+    };
+
+    uint32_t victim(uint32_t set) const;
+    void touch(uint32_t set, uint32_t way);
+
+    CacheConfig config;
+    uint32_t sets;
+    uint32_t offsetBits;
+    uint32_t setBits;
+    uint32_t setMask;
+
+    vector<uint32_t> tags;    // sets * ways
+    vector<uint8_t> state;    // LineState bits, sets * ways
+    vector<uint64_t> lastUse; // LRU: access stamp of every line, sets * ways
+    vector<uint32_t> plru;    // PLRU: tree bits of every set
+    uint64_t clock = 0;       // LRU access stamp
+};
+
+#endif // CACHE_HPP
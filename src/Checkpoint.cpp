@@ -0,0 +1,270 @@
+#include <fstream>
+#include <sstream>
+#include "Processor.hpp"
+
+namespace {
+const uint32_t kCheckpointMagic = 0x4B435652; // "RVCK"
+const uint32_t kCheckpointVersion = 5; // 4 added the issue width, 5 the last diagram column
+
+// Identifies the program a checkpoint belongs to (FNV-1a of the instruction words)
+uint64_t programHash(const vector<DecodedInstruction>& program) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const DecodedInstruction& decoded : program) {
+        for (int byte = 0; byte < 4; byte++) {
+            hash = (hash ^ ((decoded.instruction >> (8 * byte)) & 0xFF)) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+// A pipeline register is stored as raw bytes, with its decoded instruction
+// replaced by the index of that instruction in the program
+const uint32_t kNoInstructionIndex = UINT32_MAX;
+
+template <typename Latch>
+void writeLatch(CheckpointWriter& out, const Latch& latch, const vector<DecodedInstruction>& program) {
+    Latch copy = latch;
+    copy.decoded = nullptr;
+    out.write(copy);
+    out.write<uint32_t>(latch.decoded == &kNoInstruction ? kNoInstructionIndex : latch.decoded - program.data());
+}
+
+template <typename Latch>
+bool readLatch(CheckpointReader& in, Latch& latch, const vector<DecodedInstruction>& program) {
+    uint32_t index;
+    if (!in.read(latch) || !in.read(index)) return false;
+    if (index == kNoInstructionIndex) {
+        latch.decoded = &kNoInstruction;
+    } else if (index < program.size()) {
+        latch.decoded = &program[index];
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Optional component: its configuration ("" when there is none), then its
+// state as one length-prefixed block, so that a run configured differently
+// can skip it
+void writeComponent(CheckpointWriter& out, const string& config, const function<void(CheckpointWriter&)>& save) {
+    out.writeString(config);
+    ostringstream state;
+    if (!config.empty()) {
+        CheckpointWriter stateOut(state);
+        save(stateOut);
+    }
+    out.writeString(state.str());
+}
+
+// Restore the component if the checkpoint holds one with the configuration
+// of this run; otherwise it starts cold (restore is not called). Returns
+// false on a malformed checkpoint.
+bool readComponent(CheckpointReader& in, const char* name, const string& config,
+                   const function<bool(CheckpointReader&)>& restore) {
+    string saved;
+    string state;
+    if (!in.readString(saved) || !in.readString(state, UINT32_MAX)) return false;
+    if (config.empty()) return true;
+    if (saved != config) {
+        cerr << "Note: checkpoint has " << (saved.empty() ? string("no ") + name : name + string(" ") + saved)
+             << "; the " << name << " " << config << " starts cold" << endl;
+        return true;
+    }
+    istringstream stateIn(state);
+    CheckpointReader componentIn(stateIn);
+    return restore(componentIn);
+}
+} // namespace
+
+void Processor::saveCheckpoint(ostream& out) const {
+    CheckpointWriter writer(out);
+    writer.write(kCheckpointMagic);
+    writer.write(kCheckpointVersion);
+    // Layout of the raw pipeline registers: a different build cannot read them
+    writer.write<uint32_t>(sizeof(IF_ID_Register));
+    writer.write<uint32_t>(sizeof(ID_EX_Register));
+    writer.write<uint32_t>(sizeof(EX_MEM_Register));
+    writer.write<uint32_t>(sizeof(MEM_WB_Register));
+    writer.write<uint32_t>(instructionMemory.size());
+    writer.write(programHash(instructionMemory));
+    // The stages of a split fetch, execute or memory stage are pipeline registers too
+    writer.write(depth.fetch);
+    writer.write(depth.execute);
+    writer.write(depth.memory);
+    // ... and so are the registers of every issue slot
+    writer.write(issueWidth);
+
+    writer.write<int32_t>(currentCycle);
+    writer.write(pc);
+    writer.write(registers);
+    writer.write(isBranch);
+    writer.write(branchTarget);
+    writer.write(haltRequested);
+    writer.write(fetchFault);
+    for (const PipelineSlot* lane = slots; lane != slots + issueWidth; lane++) {
+        writeLatch(writer, lane->if_id, instructionMemory);
+        writeLatch(writer, lane->id_ex, instructionMemory);
+        writeLatch(writer, lane->ex_mem, instructionMemory);
+        writeLatch(writer, lane->mem_wb, instructionMemory);
+        for (const IF_ID_Register& latch : lane->fetchLine) writeLatch(writer, latch, instructionMemory);
+        for (const EX_MEM_Register& latch : lane->executeLine) writeLatch(writer, latch, instructionMemory);
+        for (const MEM_WB_Register& latch : lane->memoryLine) writeLatch(writer, latch, instructionMemory);
+    }
+    memory.save(writer);
+    // Results of the multiplier/divider are part of the register state
+    vector<MulDivUnit::Result> results;
+    if (mulDivUnit) {
+        results = mulDivUnit->pendingResults();
+    }
+    writer.write<uint32_t>(results.size());
+    writer.writeVector(results);
+    // The last cycle of the diagram, which decides the stall marks of the first restored one
+    vector<uint32_t> lastColumn = pipelineTrace.cellsBefore(currentCycle);
+    writer.write<uint32_t>(lastColumn.size());
+    writer.writeVector(lastColumn);
+
+    // Warmed-up microarchitectural state, with the access each cache is in the middle of
+    writeComponent(writer, dataCache ? dataCache->getConfig().describe() : "", [&](CheckpointWriter& state) {
+        dataCache->save(state);
+        state.write(memAccessStarted);
+        state.write(memWaitCycles);
+    });
+    writeComponent(writer, instructionCache ? instructionCache->getConfig().describe() : "", [&](CheckpointWriter& state) {
+        instructionCache->save(state);
+        state.write(fetchAccessStarted);
+        state.write(fetchWaitCycles);
+    });
+    writeComponent(writer, branchPredictor ? branchPredictor->getConfig().describe() : "", [&](CheckpointWriter& state) {
+        branchPredictor->save(state);
+    });
+    writeComponent(writer, mulDivUnit ? mulDivUnit->getConfig().describe() : "", [&](CheckpointWriter& state) {
+        mulDivUnit->save(state);
+    });
+}
+
+bool Processor::restoreCheckpoint(istream& in) {
+    CheckpointReader reader(in);
+    uint32_t magic, version, layout[4], instructions;
+    uint64_t hash;
+    if (!reader.read(magic) || magic != kCheckpointMagic || !reader.read(version) || version != kCheckpointVersion) {
+        cerr << "Error: not a checkpoint of this simulator" << endl;
+        return false;
+    }
+    if (!reader.read(layout) || layout[0] != sizeof(IF_ID_Register) || layout[1] != sizeof(ID_EX_Register) ||
+        layout[2] != sizeof(EX_MEM_Register) || layout[3] != sizeof(MEM_WB_Register)) {
+        cerr << "Error: checkpoint was written by a different build of the simulator" << endl;
+        return false;
+    }
+    if (!reader.read(instructions) || !reader.read(hash) ||
+        instructions != instructionMemory.size() || hash != programHash(instructionMemory)) {
+        cerr << "Error: checkpoint was taken from a different program" << endl;
+        return false;
+    }
+    PipelineDepth saved;
+    if (!reader.read(saved.fetch) || !reader.read(saved.execute) || !reader.read(saved.memory)) {
+        cerr << "Error: checkpoint is truncated or corrupt" << endl;
+        return false;
+    }
+    if (saved != depth) {
+        cerr << "Error: checkpoint was taken with pipeline depth " << saved.describe() << ", not "
+             << depth.describe() << endl;
+        return false;
+    }
+    uint32_t savedWidth;
+    if (!reader.read(savedWidth)) {
+        cerr << "Error: checkpoint is truncated or corrupt" << endl;
+        return false;
+    }
+    if (savedWidth != issueWidth) {
+        cerr << "Error: checkpoint was taken with issue width " << savedWidth << ", not " << issueWidth << endl;
+        return false;
+    }
+
+    // Start from a clean processor so that nothing survives a failed restore
+    reset(false);
+    int32_t cycle;
+    bool valid = reader.read(cycle) && cycle >= 0 && reader.read(pc) && reader.read(registers) &&
+        reader.read(isBranch) && reader.read(branchTarget) && reader.read(haltRequested) &&
+        reader.read(fetchFault);
+    for (PipelineSlot* lane = slots; lane != slots + issueWidth; lane++) {
+        valid = valid &&
+            readLatch(reader, lane->if_id, instructionMemory) && readLatch(reader, lane->id_ex, instructionMemory) &&
+            readLatch(reader, lane->ex_mem, instructionMemory) && readLatch(reader, lane->mem_wb, instructionMemory);
+        for (IF_ID_Register& latch : lane->fetchLine) valid = valid && readLatch(reader, latch, instructionMemory);
+        for (EX_MEM_Register& latch : lane->executeLine) valid = valid && readLatch(reader, latch, instructionMemory);
+        for (MEM_WB_Register& latch : lane->memoryLine) valid = valid && readLatch(reader, latch, instructionMemory);
+    }
+    valid = valid && memory.restore(reader);
+    // At most one result per register can be waiting
+    uint32_t pendingResults = 0;
+    valid = valid && reader.read(pendingResults) && pendingResults < 32;
+    vector<MulDivUnit::Result> results(valid ? pendingResults : 0);
+    valid = valid && reader.readVector(results);
+    for (const MulDivUnit::Result& result : results) {
+        // Without a multiplier/divider the value is simply there already
+        if (mulDivUnit) {
+            mulDivUnit->schedule(result);
+        } else {
+            setRegister(result.rd, result.value);
+        }
+    }
+    registers[0] = 0;
+    // A cycle touches every row at most once
+    uint32_t lastCells = 0;
+    valid = valid && reader.read(lastCells) && lastCells <= instructionMemory.size();
+    vector<uint32_t> lastColumn(valid ? lastCells : 0);
+    valid = valid && reader.readVector(lastColumn);
+    // Later fetches are numbered after the instructions in flight
+    fetchSeq = 0;
+    for (const PipelineSlot* lane = slots; lane != slots + issueWidth; lane++) {
+        fetchSeq = max(fetchSeq, max(max(lane->if_id.seq, lane->id_ex.seq), max(lane->ex_mem.seq, lane->mem_wb.seq)) + 1);
+        for (const IF_ID_Register& latch : lane->fetchLine) fetchSeq = max(fetchSeq, latch.seq + 1);
+        for (const EX_MEM_Register& latch : lane->executeLine) fetchSeq = max(fetchSeq, latch.seq + 1);
+        for (const MEM_WB_Register& latch : lane->memoryLine) fetchSeq = max(fetchSeq, latch.seq + 1);
+    }
+    valid = valid &&
+        readComponent(reader, "dcache", dataCache ? dataCache->getConfig().describe() : "", [&](CheckpointReader& state) {
+            return dataCache->restore(state) && state.read(memAccessStarted) && state.read(memWaitCycles);
+        }) &&
+        readComponent(reader, "icache", instructionCache ? instructionCache->getConfig().describe() : "", [&](CheckpointReader& state) {
+            return instructionCache->restore(state) && state.read(fetchAccessStarted) && state.read(fetchWaitCycles);
+        }) &&
+        readComponent(reader, "predictor", branchPredictor ? branchPredictor->getConfig().describe() : "", [&](CheckpointReader& state) {
+            return branchPredictor->restore(state);
+        }) &&
+        readComponent(reader, "muldiv", mulDivUnit ? mulDivUnit->getConfig().describe() : "", [&](CheckpointReader& state) {
+            return mulDivUnit->restore(state);
+        });
+    if (!valid) {
+        cerr << "Error: checkpoint is truncated or corrupt" << endl;
+        reset(false);
+        memory.clear();
+        return false;
+    }
+    // The diagram and the counters cover the cycles simulated from here on
+    currentCycle = startCycle = cycle;
+    pipelineTrace.clear(startCycle);
+    pipelineTrace.setCellsBefore(lastColumn);
+    return true;
+}
+
+bool Processor::saveCheckpoint(const string& filename) const {
+    ofstream out(filename, ios::binary);
+    if (out) {
+        saveCheckpoint(out);
+    }
+    if (!out) {
+        cerr << "Error writing checkpoint " << filename << endl;
+        return false;
+    }
+    return true;
+}
+
+bool Processor::restoreCheckpoint(const string& filename) {
+    ifstream in(filename, ios::binary);
+    if (!in) {
+        cerr << "Error: Could not open checkpoint " << filename << endl;
+        return false;
+    }
+    return restoreCheckpoint(in);
+}
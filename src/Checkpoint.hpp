@@ -0,0 +1,84 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+// Binary encoding of a checkpoint: plain values are stored with their host
+// representation, vectors and strings with a 64-bit length first. A
+// checkpoint is only read back by the build that wrote it (see
+// Processor::saveCheckpoint), so no byte order conversion is done.
+class CheckpointWriter {
+public:
+    explicit CheckpointWriter(ostream& out) : out(out) {}
+
+    template <typename T>
+    void write(const T& value) {
+        static_assert(is_trivially_copyable<T>::value, "written as raw bytes");
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    template <typename T>
+    void writeVector(const vector<T>& values) {
+        static_assert(is_trivially_copyable<T>::value, "written as raw bytes");
+        write<uint64_t>(values.size());
+        out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    }
+    void writeString(const string& text) {
+        write<uint64_t>(text.size());
+        out.write(text.data(), text.size());
+    }
+    void writeBytes(const void* data, size_t size) {
+        out.write(static_cast<const char*>(data), size);
+    }
+    bool good() const { return out.good(); }
+
+private:
+    ostream& out;
+};
+
+// Reads what CheckpointWriter wrote. Every read returns false on a short or
+// inconsistent input; the value read into is then unspecified.
+class CheckpointReader {
+public:
+    explicit CheckpointReader(istream& in) : in(in) {}
+
+    template <typename T>
+    bool read(T& value) {
+        static_assert(is_trivially_copyable<T>::value, "read as raw bytes");
+        return readBytes(&value, sizeof(T));
+    }
+    // The stored length must equal values.size(): the tables a checkpoint
+    // restores are sized by a configuration that has already been checked
+    template <typename T>
+    bool readVector(vector<T>& values) {
+        static_assert(is_trivially_copyable<T>::value, "read as raw bytes");
+        uint64_t size;
+        if (!read(size) || size != values.size()) return false;
+        return readBytes(values.data(), values.size() * sizeof(T));
+    }
+    bool readString(string& text, uint64_t maxSize = 4096) {
+        uint64_t size;
+        if (!read(size) || size > maxSize) return false;
+        text.resize(size);
+        return readBytes(&text[0], size);
+    }
+    bool readBytes(void* data, size_t size) {
+        in.read(static_cast<char*>(data), size);
+        return static_cast<size_t>(in.gcount()) == size;
+    }
+    bool skip(uint64_t size) {
+        in.seekg(size, ios::cur);
+        return in.good();
+    }
+
+private:
+    istream& in;
+};
+
+#endif // CHECKPOINT_HPP
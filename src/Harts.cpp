@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "Harts.hpp"
+
+namespace {
+
+// Reusable barrier for a fixed number of threads. The last thread to arrive
+// runs `completion` before any of them is released, so whatever it decides
+// is seen by all of them.
+class QuantumBarrier {
+public:
+    QuantumBarrier(size_t threads, function<void()> completion)
+        : threads(threads), completion(move(completion)) {}
+
+    void arriveAndWait() {
+        unique_lock<mutex> lock(guard);
+        uint64_t phase = generation;
+        if (++arrived == threads) {
+            completion();
+            arrived = 0;
+            generation++;
+            released.notify_all();
+            return;
+        }
+        released.wait(lock, [&]() { return generation != phase; });
+    }
+
+private:
+    size_t threads;
+    function<void()> completion;
+    mutex guard;
+    condition_variable released;
+    size_t arrived = 0;
+    uint64_t generation = 0;
+};
+
+} // namespace
+
+HartGroup::HartGroup(const string& filename, uint32_t count) {
+    for (uint32_t id = 0; id < count; id++) {
+        // The program is loaded and decoded once, for hart 0
+        harts.emplace_back(id == 0 ? new Processor(filename, 0) : new Processor(harts[0]->getProgram(), 0));
+        harts.back()->setHart(id, count);
+        if (id > 0) {
+            // Drops the copy of the program's data this hart loaded
+            harts.back()->shareMemory(*harts[0]);
+        }
+    }
+}
+
+void HartGroup::reset(bool untilHalt) {
+    for (auto& hart : harts) {
+        hart->reset(untilHalt);
+    }
+}
+
+int HartGroup::runLockstep(int cycles, bool untilHalt) {
+    int ran = 0;
+    while (ran < cycles) {
+        bool stepped = false;
+        for (auto& hart : harts) {
+            if (finished(*hart, untilHalt)) continue;
+            hart->step(1, untilHalt);
+            stepped = true;
+        }
+        if (!stepped) break;
+        ran++;
+    }
+    warnUnfinished(cycles, untilHalt);
+    return ran;
+}
+
+int HartGroup::runParallel(int cycles, bool untilHalt, int quantum) {
+    bool done = false; // Every hart has finished; only changed by the barrier
+    QuantumBarrier barrier(harts.size(), [&]() {
+        done = all_of(harts.begin(), harts.end(),
+                      [&](const unique_ptr<Processor>& hart) { return finished(*hart, untilHalt); });
+    });
+    vector<int> ran(harts.size(), 0);
+    vector<thread> threads;
+    for (size_t id = 0; id < harts.size(); id++) {
+        threads.emplace_back([&, id]() {
+            Processor& hart = *harts[id];
+            for (int begin = 0; begin < cycles && !done; begin += quantum) {
+                if (!hart.fetchFault) {
+                    ran[id] += hart.step(min(quantum, cycles - begin), untilHalt);
+                }
+                barrier.arriveAndWait();
+            }
+        });
+    }
+    for (thread& worker : threads) {
+        worker.join();
+    }
+    warnUnfinished(cycles, untilHalt);
+    return *max_element(ran.begin(), ran.end());
+}
+
+void HartGroup::warnUnfinished(int cycles, bool untilHalt) const {
+    if (!untilHalt) return;
+    for (const auto& hart : harts) {
+        if (!finished(*hart, untilHalt)) {
+            cerr << "Warning: hart " << hart->getHartId() << " did not finish within " << cycles << " cycles" << endl;
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef HARTS_HPP
+#define HARTS_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Processor.hpp"
+
+using namespace std;
+
+// Several cores (harts) running the same program over one shared data
+// memory, each with its own registers, pipeline, caches and predictor. The
+// program tells the harts apart by tp, which holds the hart id (see
+// Processor::setHart), and partitions its work by it. There are no atomic
+// instructions: harts communicate through plain loads and stores, and the
+// caches are private timing models that need no coherence since the data
+// itself always lives in the shared memory.
+//
+// In lock-step every hart simulates one cycle in turn, hart 0 first, so a
+// store that hart 0 makes in MEM is seen by a load of hart 1 in the same
+// cycle, and every run of a program gives the same result. In parallel every
+// hart runs on its own host thread and the harts meet at a barrier every
+// `quantum` cycles; a hart never gets more than one quantum ahead of the
+// others, but stores and loads to the same word within a quantum are seen in
+// whatever order the host threads happen to run.
+class HartGroup {
+public:
+    // `harts` processors loaded with filename, every one using hart 0's memory
+    HartGroup(const string& filename, uint32_t harts);
+
+    uint32_t size() const { return harts.size(); }
+    Processor& hart(uint32_t id) { return *harts[id]; }
+    // Processor::reset() of every hart
+    void reset(bool untilHalt);
+
+    // Simulate `cycles` cycles of every hart, or in untilHalt mode until
+    // every hart has finished with at most `cycles` cycles each. A hart that
+    // has finished (or stopped at a misaligned pc) is no longer stepped.
+    // Returns the cycles of the hart that ran longest.
+    int runLockstep(int cycles, bool untilHalt);
+    int runParallel(int cycles, bool untilHalt, int quantum);
+
+private:
+    // The hart has nothing left to simulate
+    bool finished(const Processor& hart, bool untilHalt) const {
+        return hart.fetchFault || (untilHalt && hart.isHalted());
+    }
+    void warnUnfinished(int cycles, bool untilHalt) const;
+
+    vector<unique_ptr<Processor>> harts;
+};
+
+#endif // HARTS_HPP
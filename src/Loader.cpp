@@ -0,0 +1,408 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Loader.hpp"
+#include "Processor.hpp"
+
+MappedFile::~MappedFile() {
+    if (mapping) {
+        munmap(mapping, length);
+    }
+}
+
+bool MappedFile::open(const string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        void* address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address != MAP_FAILED) {
+            mapping = address;
+            length = info.st_size;
+            close(fd);
+            return true;
+        }
+    }
+    close(fd);
+    // Empty file, pipe, or a system without mmap for it
+    ifstream in(filename, ios::binary);
+    if (!in) return false;
+    buffer.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    length = buffer.size();
+    return true;
+}
+
+namespace {
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Listing: one pass over the mapped text, taking the hex word and the
+// trimmed assembly of every non-blank line
+bool parseListing(const char* data, size_t size, ProgramImage& image, string& error) {
+    const char* end = data + size;
+
+    size_t lineNumber = 0;
+    for (const char* line = data; line < end;) {
+        const char* lineEnd = static_cast<const char*>(memchr(line, '\n', end - line));
+        if (!lineEnd) lineEnd = end;
+        const char* p = line;
+        line = lineEnd + 1;
+        lineNumber++;
+
+        while (p < lineEnd && isSpace(*p)) p++;
+        if (p == lineEnd) continue; // Blank line
+
+        // Hex word, with an optional 0x; anything else in the token is ignored
+        const char* token = p;
+        if (lineEnd - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X') && hexDigit(p[2]) >= 0) p += 2;
+        uint32_t word = 0;
+        int digits = 0;
+        for (int digit; p < lineEnd && (digit = hexDigit(*p)) >= 0; p++, digits++) {
+            word = (word << 4) | digit;
+        }
+        if (digits == 0) {
+            error = "line " + to_string(lineNumber) + ": expected an instruction in hex, found \"" +
+                string(token, find_if(token, lineEnd, isSpace)) + "\"";
+            return false;
+        }
+        while (p < lineEnd && !isSpace(*p)) p++;
+
+        // Assembly text, trimmed, without a "<label>"
+        const char* textBegin = p;
+        const char* textEnd = lineEnd;
+        while (textBegin < textEnd && isSpace(*textBegin)) textBegin++;
+        while (textEnd > textBegin && isSpace(textEnd[-1])) textEnd--;
+        const char* open = find(textBegin, textEnd, '<');
+        const char* close = open < textEnd ? find(open, textEnd, '>') : textEnd;
+        image.words.push_back(word);
+        if (close == textEnd) {
+            image.text.emplace_back(textBegin, textEnd);
+            continue;
+        }
+        string text(textBegin, open);
+        text.append(close + 1, textEnd);
+        size_t first = text.find_first_not_of(" \t\r\n");
+        size_t last = text.find_last_not_of(" \t\r\n");
+        image.text.push_back(first == string::npos ? string() : text.substr(first, last - first + 1));
+    }
+    return true;
+}
+
+void addWords(const char* data, size_t size, ProgramImage& image) {
+    size_t count = size / 4;
+    image.words.resize(count);
+    image.text.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data) + 4 * i;
+        image.words[i] = p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+        image.text.push_back(disassemble(image.words[i]));
+    }
+}
+
+// Little-endian fields of an ELF file
+uint16_t elfHalf(const char* p) {
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return u[0] | (u[1] << 8);
+}
+
+uint32_t elfWord(const char* p) {
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return u[0] | (u[1] << 8) | (u[2] << 16) | (uint32_t(u[3]) << 24);
+}
+
+bool isElf(const char* data, size_t size) {
+    return size >= 4 && memcmp(data, "\x7f" "ELF", 4) == 0;
+}
+
+const size_t kElfHeaderSize = 52;
+const size_t kProgramHeaderSize = 32;
+const size_t kSectionHeaderSize = 40;
+enum ElfConstants : uint32_t {
+    ET_REL = 1,
+    ET_EXEC = 2,
+    EM_RISCV = 243,
+    EF_RISCV_RVC = 0x1,
+    PT_LOAD = 1,
+    SHT_SYMTAB = 2,
+    SHT_NOBITS = 8,
+    SHF_ALLOC = 0x2,
+    SHF_EXECINSTR = 0x4
+};
+
+struct ElfSection {
+    string name;
+    uint32_t type, flags, address, offset, size, link;
+};
+
+// True if [offset, offset + length) lies inside the file
+bool inFile(size_t size, uint32_t offset, uint32_t length) {
+    return offset <= size && size - offset >= length;
+}
+
+bool readElfSections(const char* data, size_t size, vector<ElfSection>& sections, string& error) {
+    uint32_t tableOffset = elfWord(data + 32);
+    uint16_t count = elfHalf(data + 48);
+    uint16_t namesIndex = elfHalf(data + 50);
+    if (elfHalf(data + 46) != kSectionHeaderSize || namesIndex >= count ||
+        !inFile(size, tableOffset, count * kSectionHeaderSize)) {
+        error = "malformed ELF section headers";
+        return false;
+    }
+    const char* names = data + tableOffset + namesIndex * kSectionHeaderSize;
+    uint32_t namesOffset = elfWord(names + 16);
+    uint32_t namesSize = elfWord(names + 20);
+    if (!inFile(size, namesOffset, namesSize)) {
+        error = "malformed ELF section names";
+        return false;
+    }
+    sections.resize(count);
+    for (uint16_t i = 0; i < count; i++) {
+        const char* header = data + tableOffset + i * kSectionHeaderSize;
+        ElfSection& section = sections[i];
+        uint32_t name = elfWord(header);
+        if (name < namesSize) {
+            const char* text = data + namesOffset + name;
+            section.name.assign(text, strnlen(text, namesSize - name));
+        }
+        section.type = elfWord(header + 4);
+        section.flags = elfWord(header + 8);
+        section.address = elfWord(header + 12);
+        section.offset = elfWord(header + 16);
+        section.size = elfWord(header + 20);
+        section.link = elfWord(header + 24);
+        if (section.type != SHT_NOBITS && !inFile(size, section.offset, section.size)) {
+            error = "ELF section " + section.name + " lies outside the file";
+            return false;
+        }
+        if (uint64_t(section.address) + section.size > (uint64_t(1) << 32)) {
+            error = "ELF section " + section.name + " runs past the end of the address space";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Value of a symbol of the symbol table, if there is one
+bool findElfSymbol(const char* data, const vector<ElfSection>& sections, const char* name, uint32_t& value) {
+    for (const ElfSection& symbols : sections) {
+        if (symbols.type != SHT_SYMTAB || symbols.link >= sections.size()) continue;
+        const ElfSection& names = sections[symbols.link];
+        if (names.type == SHT_NOBITS) continue; // Not in the file
+        // The whole name, with its terminating NUL, must be in the string table
+        size_t length = strlen(name) + 1;
+        for (uint32_t offset = 0; offset + 16 <= symbols.size; offset += 16) {
+            const char* symbol = data + symbols.offset + offset;
+            uint32_t nameOffset = elfWord(symbol);
+            if (nameOffset < names.size && names.size - nameOffset >= length &&
+                memcmp(data + names.offset + nameOffset, name, length) == 0) {
+                value = elfWord(symbol + 4);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Statically linked executable: the executable sections, from the lowest to
+// the highest address, are the instructions; every PT_LOAD segment is data
+bool loadElfExecutable(const char* data, size_t size, const vector<ElfSection>& sections,
+                       ProgramImage& image, string& error) {
+    // 64-bit, so that a section ending at 2^32 does not wrap to 0
+    uint64_t low = UINT32_MAX, high = 0;
+    for (const ElfSection& section : sections) {
+        if ((section.flags & (SHF_ALLOC | SHF_EXECINSTR)) != (SHF_ALLOC | SHF_EXECINSTR) ||
+            section.type == SHT_NOBITS || section.size == 0) continue;
+        low = min<uint64_t>(low, section.address);
+        high = max<uint64_t>(high, uint64_t(section.address) + section.size);
+    }
+    if (low > high) {
+        error = "ELF file has no executable section";
+        return false;
+    }
+    if (low % 4 != 0) {
+        error = "executable sections are not word aligned";
+        return false;
+    }
+    if (high - low > (256u << 20)) {
+        error = "executable sections span more than 256 MiB";
+        return false;
+    }
+    // Code between the executable sections (alignment padding) reads as 0
+    vector<char> code(high - low, 0);
+    for (const ElfSection& section : sections) {
+        if ((section.flags & (SHF_ALLOC | SHF_EXECINSTR)) != (SHF_ALLOC | SHF_EXECINSTR) ||
+            section.type == SHT_NOBITS || section.size == 0) continue;
+        memcpy(&code[section.address - low], data + section.offset, section.size);
+    }
+    image.base = static_cast<uint32_t>(low);
+    addWords(code.data(), code.size(), image);
+
+    uint32_t tableOffset = elfWord(data + 28);
+    uint16_t count = elfHalf(data + 44);
+    if (count > 0 && (elfHalf(data + 42) != kProgramHeaderSize ||
+                      !inFile(size, tableOffset, count * kProgramHeaderSize))) {
+        error = "malformed ELF program headers";
+        return false;
+    }
+    for (uint16_t i = 0; i < count; i++) {
+        const char* header = data + tableOffset + i * kProgramHeaderSize;
+        if (elfWord(header) != PT_LOAD) continue;
+        uint32_t offset = elfWord(header + 4);
+        uint32_t fileSize = elfWord(header + 16);
+        if (!inFile(size, offset, fileSize)) {
+            error = "ELF segment lies outside the file";
+            return false;
+        }
+        ProgramImage::Segment segment;
+        segment.address = elfWord(header + 8);
+        segment.bytes.assign(data + offset, data + offset + fileSize);
+        image.segments.push_back(move(segment));
+    }
+
+    image.executable = true;
+    image.entry = elfWord(data + 24);
+    findElfSymbol(data, sections, "__global_pointer$", image.globalPointer);
+    return true;
+}
+
+bool loadElf(const char* data, size_t size, ProgramImage& image, string& error) {
+    if (size < kElfHeaderSize) {
+        error = "truncated ELF header";
+        return false;
+    }
+    if (data[4] != 1 || data[5] != 1) {
+        error = "only 32-bit little-endian ELF files are supported";
+        return false;
+    }
+    if (elfHalf(data + 18) != EM_RISCV) {
+        error = "ELF file is not for RISC-V";
+        return false;
+    }
+    if (elfWord(data + 36) & EF_RISCV_RVC) {
+        error = "compressed instructions are not supported (build for rv32im)";
+        return false;
+    }
+    vector<ElfSection> sections;
+    if (!readElfSections(data, size, sections, error)) return false;
+
+    uint16_t type = elfHalf(data + 16);
+    if (type == ET_EXEC) {
+        return loadElfExecutable(data, size, sections, image, error);
+    }
+    if (type != ET_REL) {
+        error = "ELF file is neither a static executable nor an object file";
+        return false;
+    }
+    // Object file: its .text at address 0, like a listing
+    for (const ElfSection& section : sections) {
+        if (section.name == ".text") {
+            addWords(data + section.offset, section.size, image);
+            return true;
+        }
+    }
+    error = "ELF file has no .text section";
+    return false;
+}
+
+bool hasExtension(const string& filename, const char* extension) {
+    size_t length = strlen(extension);
+    return filename.size() >= length && filename.compare(filename.size() - length, length, extension) == 0;
+}
+
+string reg(uint32_t index) {
+    return " x" + to_string(index);
+}
+} // namespace
+
+bool loadProgramImage(const string& filename, ProgramImage& image, string& error) {
+    MappedFile file;
+    if (!file.open(filename)) {
+        error = "Could not open file " + filename;
+        return false;
+    }
+    image = ProgramImage();
+    bool loaded;
+    if (isElf(file.data(), file.size())) {
+        loaded = loadElf(file.data(), file.size(), image, error);
+    } else if (hasExtension(filename, ".bin")) {
+        addWords(file.data(), file.size(), image);
+        loaded = true;
+    } else {
+        loaded = parseListing(file.data(), file.size(), image, error);
+    }
+    if (!loaded) {
+        error = filename + ": " + error;
+    }
+    return loaded;
+}
+
+string disassemble(uint32_t instruction) {
+    static const char* const kRegisterOps[8] = {"add", "sll", "slt", "sltu", "xor", "srl", "or", "and"};
+    static const char* const kMulDivOps[8] = {"mul", "mulh", "mulhsu", "mulhu", "div", "divu", "rem", "remu"};
+    static const char* const kImmediateOps[8] = {"addi", "slli", "slti", "sltiu", "xori", "srli", "ori", "andi"};
+    static const char* const kLoads[8] = {"lb", "lh", "lw", nullptr, "lbu", "lhu", nullptr, nullptr};
+    static const char* const kStores[8] = {"sb", "sh", "sw", nullptr, nullptr, nullptr, nullptr, nullptr};
+    static const char* const kBranches[8] = {"beq", "bne", nullptr, nullptr, "blt", "bge", "bltu", "bgeu"};
+
+    uint32_t opcode = instruction & 0x7F;
+    uint32_t rd = (instruction >> 7) & 0x1F;
+    uint32_t funct3 = (instruction >> 12) & 0x7;
+    uint32_t rs1 = (instruction >> 15) & 0x1F;
+    uint32_t rs2 = (instruction >> 20) & 0x1F;
+    uint32_t funct7 = instruction >> 25;
+    int32_t immediate = InstructionDecode::extractImmediate(instruction, InstructionDecode::getInstructionType(instruction));
+
+    switch (opcode) {
+    case 0b0110011: // R-type
+        if (funct7 == 0x01) return kMulDivOps[funct3] + reg(rd) + reg(rs1) + reg(rs2);
+        if (funct7 == 0x20 && funct3 == 0x0) return "sub" + reg(rd) + reg(rs1) + reg(rs2);
+        if (funct7 == 0x20 && funct3 == 0x5) return "sra" + reg(rd) + reg(rs1) + reg(rs2);
+        if (funct7 == 0x00) return kRegisterOps[funct3] + reg(rd) + reg(rs1) + reg(rs2);
+        break;
+    case 0b0010011: // I-type ALU; shifts take a 5-bit amount
+        if (funct3 == 0x1 || funct3 == 0x5) {
+            const char* name = funct3 == 0x1 ? "slli" : (funct7 == 0x20 ? "srai" : "srli");
+            return name + reg(rd) + reg(rs1) + " " + to_string(rs2);
+        }
+        return kImmediateOps[funct3] + reg(rd) + reg(rs1) + " " + to_string(immediate);
+    case 0b0000011: // Load
+        if (kLoads[funct3]) return kLoads[funct3] + reg(rd) + " " + to_string(immediate) + reg(rs1);
+        break;
+    case 0b0100011: // Store
+        if (kStores[funct3]) return kStores[funct3] + reg(rs2) + " " + to_string(immediate) + reg(rs1);
+        break;
+    case 0b1100011: // Branch
+        if (kBranches[funct3]) return kBranches[funct3] + reg(rs1) + reg(rs2) + " " + to_string(immediate);
+        break;
+    case 0b1101111: // JAL
+        return "jal" + reg(rd) + " " + to_string(immediate);
+    case 0b1100111: // JALR
+        return "jalr" + reg(rd) + reg(rs1) + " " + to_string(immediate);
+    case 0b0110111: // LUI
+    case 0b0010111: { // AUIPC
+        char upper[16];
+        snprintf(upper, sizeof(upper), " 0x%x", instruction >> 12);
+        return (opcode == 0b0110111 ? "lui" : "auipc") + reg(rd) + upper;
+    }
+    case 0b1110011:
+        if (instruction == 0x00000073) return "ecall";
+        if (instruction == 0x00100073) return "ebreak";
+        break;
+    }
+    char word[24];
+    snprintf(word, sizeof(word), ".word 0x%08x", instruction);
+    return word;
+}
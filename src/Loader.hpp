@@ -0,0 +1,66 @@
+#ifndef LOADER_HPP
+#define LOADER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Read-only view of a whole file. The file is memory-mapped when the system
+// allows it (regular files) and read into memory otherwise.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const string& filename);
+    const char* data() const { return mapping ? static_cast<const char*>(mapping) : buffer.data(); }
+    size_t size() const { return length; }
+
+private:
+    void* mapping = nullptr;
+    size_t length = 0;
+    vector<char> buffer; // Contents when the file could not be mapped
+};
+
+// Instructions of a program and the text the pipeline diagram shows for
+// each of them. Listings and raw binaries only fill base (0), words and
+// text; an ELF executable also brings the initial memory contents and
+// where execution starts.
+struct ProgramImage {
+    struct Segment {
+        uint32_t address = 0;
+        vector<uint8_t> bytes; // File contents; the rest of the segment (.bss) is zero
+    };
+
+    uint32_t base = 0; // Address of words[0]
+    vector<uint32_t> words;
+    vector<string> text;
+
+    bool executable = false;    // Loaded from an ELF executable
+    uint32_t entry = 0;         // Initial pc
+    uint32_t globalPointer = 0; // Value of __global_pointer$, if the program defines it
+    vector<Segment> segments;   // Loadable segments, copied into data memory
+};
+
+// Load a program from one of:
+//   - a listing, one "<hex word> <assembly>" per line; a "<label>" in the
+//     assembly is dropped
+//   - a raw little-endian binary of instruction words (*.bin)
+//   - a 32-bit little-endian RISC-V ELF file: for an executable, the
+//     executable sections become the instructions (at their addresses) and
+//     every loadable segment is placed in data memory; for an object file,
+//     its .text section is placed at address 0
+// Binary programs are labelled with their disassembly. Returns false and
+// sets error on failure.
+bool loadProgramImage(const string& filename, ProgramImage& image, string& error);
+
+// Assembly text of one instruction in the style of the listings
+// (e.g. "lw x5 8 x2"), ".word 0x..." for anything else
+string disassemble(uint32_t instruction);
+
+#endif // LOADER_HPP
@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <vector>
+#include "Memory.hpp"
+
+DataMemory::PageStore::~PageStore() {
+    for (uint32_t i = 0; i < kTableSize; i++) {
+        PageEntry* table = directory[i].load(memory_order_relaxed);
+        if (!table) continue;
+        for (uint32_t j = 0; j < kTableSize; j++) {
+            delete[] table[j].load(memory_order_relaxed);
+        }
+        delete[] table;
+    }
+}
+
+void DataMemory::share(DataMemory& other) {
+    store = other.store;
+    shared = true;
+    other.shared = true;
+    lastPageNumber = 0;
+    lastPage = nullptr;
+}
+
+void DataMemory::clear() {
+    // Pages of a store are never freed while it is in use, so other views
+    // may keep pointers into it; the old store goes with its last view
+    store = make_shared<PageStore>();
+    shared = false;
+    lastPageNumber = 0;
+    lastPage = nullptr;
+}
+
+uint8_t* DataMemory::allocatePage(uint32_t pageNumber) {
+    lock_guard<mutex> lock(store->allocation);
+    atomic<PageEntry*>& slot = store->directory[pageNumber >> kTableBits];
+    PageEntry* table = slot.load(memory_order_acquire);
+    if (!table) {
+        table = new PageEntry[kTableSize]();
+        slot.store(table, memory_order_release);
+    }
+    PageEntry& entry = table[pageNumber & (kTableSize - 1)];
+    uint8_t* page = entry.load(memory_order_acquire);
+    if (!page) {
+        page = new uint8_t[kPageSize]();
+        entry.store(page, memory_order_release);
+    }
+    lastPageNumber = pageNumber;
+    lastPage = page;
+    return lastPage;
+}
+
+void DataMemory::load(uint32_t address, const uint8_t* bytes, size_t size) {
+    while (size > 0) {
+        uint32_t offset = address & kPageOffsetMask;
+        size_t chunk = min<size_t>(size, kPageSize - offset);
+        memcpy(getPage(address) + offset, bytes, chunk);
+        address += chunk;
+        bytes += chunk;
+        size -= chunk;
+    }
+}
+
+void DataMemory::save(CheckpointWriter& out) const {
+    vector<uint32_t> pageNumbers;
+    for (uint32_t i = 0; i < kTableSize; i++) {
+        const PageEntry* table = store->directory[i].load(memory_order_acquire);
+        if (!table) continue;
+        for (uint32_t j = 0; j < kTableSize; j++) {
+            const uint8_t* page = table[j].load(memory_order_acquire);
+            // Pages that were written back to zero read the same as no page
+            if (page && any_of(page, page + kPageSize, [](uint8_t byte) { return byte != 0; })) {
+                pageNumbers.push_back((i << kTableBits) | j);
+            }
+        }
+    }
+    out.write<uint32_t>(pageNumbers.size());
+    for (uint32_t pageNumber : pageNumbers) {
+        out.write(pageNumber);
+        out.writeBytes(findPage(pageNumber << kPageBits), kPageSize);
+    }
+}
+
+bool DataMemory::restore(CheckpointReader& in) {
+    clear();
+    uint32_t pages;
+    if (!in.read(pages)) return false;
+    for (uint32_t k = 0; k < pages; k++) {
+        uint32_t pageNumber;
+        if (!in.read(pageNumber) || pageNumber >= (1u << (32 - kPageBits))) return false;
+        if (!in.readBytes(allocatePage(pageNumber), kPageSize)) return false;
+    }
+    return true;
+}
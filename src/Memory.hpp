@@ -0,0 +1,156 @@
+#ifndef MEMORY_HPP
+#define MEMORY_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include "Checkpoint.hpp"
+
+using namespace std;
+
+// Sparse, byte-addressed data memory covering the whole 32-bit address space.
+// Storage is split into 4 KiB pages that are allocated the first time they are
+// written, and found through a two-level page table (10 + 10 address bits).
+// The most recently used page is remembered so that loops walking an array
+// skip the table walk entirely.
+//
+// The pages live in a store that several DataMemory objects can share (one
+// per hart, see share()). Pages are only ever added while the harts run, and
+// the table entries are published atomically, so harts on different host
+// threads may allocate pages concurrently. A shared memory reads and writes
+// the bytes themselves with relaxed atomic accesses: a whole aligned access
+// at once, any other a byte at a time. Harts that write the same word
+// without synchronizing in the simulated program see each other's values
+// in an unspecified order, as on real hardware without atomics, but never
+// a torn aligned word. A memory that is not shared uses plain copies.
+class DataMemory {
+public:
+    static constexpr uint32_t kPageBits = 12;
+    static constexpr uint32_t kPageSize = 1u << kPageBits;
+    static constexpr uint32_t kPageOffsetMask = kPageSize - 1;
+
+    DataMemory() : store(make_shared<PageStore>()) {}
+    DataMemory(const DataMemory&) = delete;
+    DataMemory& operator=(const DataMemory&) = delete;
+
+    // Little-endian access of 1, 2 or 4 bytes; unwritten memory reads as 0.
+    // Accesses inside one page are a single native load/store.
+    template <typename T>
+    T read(uint32_t address) const {
+        if (!shared && (address & kPageOffsetMask) <= kPageSize - sizeof(T)) {
+            const uint8_t* page = findPage(address);
+            if (!page) return 0;
+            T value;
+            memcpy(&value, page + (address & kPageOffsetMask), sizeof(T));
+            return value;
+        }
+        if (shared && (address & (sizeof(T) - 1)) == 0) {
+            const uint8_t* page = findPage(address);
+            if (!page) return 0;
+            return __atomic_load_n(reinterpret_cast<const T*>(page + (address & kPageOffsetMask)), __ATOMIC_RELAXED);
+        }
+        // Access straddles two pages, or is misaligned in a shared memory
+        T value = 0;
+        for (uint32_t i = 0; i < sizeof(T); i++) {
+            value |= static_cast<T>(static_cast<T>(readByte(address + i)) << (8 * i));
+        }
+        return value;
+    }
+
+    template <typename T>
+    void write(uint32_t address, T value) {
+        if (!shared && (address & kPageOffsetMask) <= kPageSize - sizeof(T)) {
+            memcpy(getPage(address) + (address & kPageOffsetMask), &value, sizeof(T));
+            return;
+        }
+        if (shared && (address & (sizeof(T) - 1)) == 0) {
+            T* word = reinterpret_cast<T*>(getPage(address) + (address & kPageOffsetMask));
+            __atomic_store_n(word, value, __ATOMIC_RELAXED);
+            return;
+        }
+        for (uint32_t i = 0; i < sizeof(T); i++) {
+            writeByte(address + i, static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    uint32_t readWord(uint32_t address) const { return read<uint32_t>(address); }
+    void writeWord(uint32_t address, uint32_t value) { write<uint32_t>(address, value); }
+    // Copy size bytes to address, a page at a time. Like save() and
+    // restore(), not to be used while other harts run on the same store.
+    void load(uint32_t address, const uint8_t* bytes, size_t size);
+
+    // Drop this memory's pages and use those of other instead; every later
+    // access of either one is seen by both, and both switch to atomic accesses
+    void share(DataMemory& other);
+    // Release every page. A shared memory starts a new, empty store of its
+    // own and leaves the others untouched.
+    void clear();
+    // Every page holding a nonzero byte, as its page number and contents;
+    // restore() replaces the whole memory with what save() wrote
+    void save(CheckpointWriter& out) const;
+    bool restore(CheckpointReader& in);
+
+private:
+    uint8_t readByte(uint32_t address) const {
+        const uint8_t* page = findPage(address);
+        if (!page) return 0;
+        const uint8_t* byte = page + (address & kPageOffsetMask);
+        return shared ? __atomic_load_n(byte, __ATOMIC_RELAXED) : *byte;
+    }
+
+    void writeByte(uint32_t address, uint8_t value) {
+        uint8_t* byte = getPage(address) + (address & kPageOffsetMask);
+        if (shared) {
+            __atomic_store_n(byte, value, __ATOMIC_RELAXED);
+        } else {
+            *byte = value;
+        }
+    }
+
+    static constexpr uint32_t kTableBits = 10;
+    static constexpr uint32_t kTableSize = 1u << kTableBits;
+
+    // Second-level table: kTableSize page pointers, nullptr until allocated
+    typedef atomic<uint8_t*> PageEntry;
+
+    // Pages of one address space, owned by every DataMemory sharing it
+    struct PageStore {
+        atomic<PageEntry*> directory[kTableSize] = {};
+        mutex allocation; // Serializes allocatePage() across harts
+        PageStore() = default;
+        PageStore(const PageStore&) = delete;
+        PageStore& operator=(const PageStore&) = delete;
+        ~PageStore();
+    };
+
+    // Page holding address, or nullptr if it was never written
+    uint8_t* findPage(uint32_t address) const {
+        uint32_t pageNumber = address >> kPageBits;
+        if (lastPage && pageNumber == lastPageNumber) return lastPage;
+        const PageEntry* table = store->directory[pageNumber >> kTableBits].load(memory_order_acquire);
+        if (!table) return nullptr;
+        uint8_t* page = table[pageNumber & (kTableSize - 1)].load(memory_order_acquire);
+        if (page) {
+            lastPageNumber = pageNumber;
+            lastPage = page;
+        }
+        return page;
+    }
+
+    // Page holding address, allocated (zero-filled) on first use
+    uint8_t* getPage(uint32_t address) {
+        uint8_t* page = findPage(address);
+        return page ? page : allocatePage(address >> kPageBits);
+    }
+
+    uint8_t* allocatePage(uint32_t pageNumber);
+
+    shared_ptr<PageStore> store;
+    bool shared = false; // Other views may use store from other host threads
+    mutable uint32_t lastPageNumber = 0;
+    mutable uint8_t* lastPage = nullptr;
+};
+
+#endif // MEMORY_HPP
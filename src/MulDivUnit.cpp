@@ -0,0 +1,103 @@
+#include <sstream>
+#include "MulDivUnit.hpp"
+
+bool MulDivConfig::parse(const string& text, MulDivConfig& config) {
+    vector<string> fields;
+    istringstream in(text);
+    string field;
+    while (getline(in, field, ':')) {
+        fields.push_back(field);
+    }
+    if (fields.size() < 2) return false;
+    vector<uint32_t> latencies;
+    try {
+        for (const string& value : fields) {
+            if (value == "pipelined") {
+                config.mulPipelined = config.divPipelined = true;
+            } else if (value == "iterative") {
+                config.mulPipelined = config.divPipelined = false;
+            } else if (latencies.size() < 3) {
+                latencies.push_back(stoul(value));
+            } else {
+                return false;
+            }
+        }
+    } catch (const exception&) {
+        return false;
+    }
+    if (latencies.size() < 2) return false;
+    config.mulLatency = latencies[0];
+    config.divLatency = latencies[1];
+    config.remLatency = latencies.size() > 2 ? latencies[2] : latencies[1];
+    // Results are scheduled by cycle number, so keep them within reach
+    for (uint32_t latency : latencies) {
+        if (latency == 0 || latency > 1024) return false;
+    }
+    return true;
+}
+
+string MulDivConfig::describe() const {
+    ostringstream out;
+    out << mulLatency << ":" << divLatency << ":" << remLatency;
+    if (mulPipelined && divPipelined) {
+        out << ":pipelined";
+    } else if (!mulPipelined && !divPipelined) {
+        out << ":iterative";
+    }
+    return out.str();
+}
+
+uint32_t MulDivUnit::latency(uint32_t aluControl) const {
+    switch (aluControl) {
+    case 11: case 16: case 17: case 18: return config.mulLatency; // MUL, MULH, MULHSU, MULHU
+    case 12: case 19: return config.divLatency; // DIV, DIVU
+    case 13: case 20: return config.remLatency; // REM, REMU
+    default: return 0;
+    }
+}
+
+bool MulDivUnit::canIssue(uint32_t aluControl, int cycle) const {
+    Kind unit = kind(aluControl);
+    return pipelined(unit) || freeCycle[unit] <= cycle;
+}
+
+bool MulDivUnit::sharesIterativeUnit(uint32_t a, uint32_t b) const {
+    return kind(a) == kind(b) && !pipelined(kind(a));
+}
+
+void MulDivUnit::issue(uint32_t aluControl, int cycle, uint32_t rd, int32_t value, int readyCycle) {
+    countOperation(aluControl);
+    freeCycle[kind(aluControl)] = cycle + latency(aluControl);
+    if (rd != 0) {
+        Result result;
+        result.rd = rd;
+        result.value = value;
+        result.readyCycle = readyCycle;
+        inFlight.push_back(result);
+    }
+}
+
+void MulDivUnit::countOperation(uint32_t aluControl) {
+    (isMultiply(aluControl) ? multiplies : aluControl == 12 || aluControl == 19 ? divides : remainders)++;
+}
+
+bool MulDivUnit::pending(uint32_t rd, int cycle) const {
+    for (const Result& result : inFlight) {
+        if (result.rd == rd && result.readyCycle > cycle) return true;
+    }
+    return false;
+}
+
+void MulDivUnit::clear() {
+    inFlight.clear();
+    for (int32_t& cycle : freeCycle) cycle = 0;
+    multiplies = divides = remainders = 0;
+}
+
+void MulDivUnit::save(CheckpointWriter& out) const {
+    out.write(freeCycle);
+}
+
+bool MulDivUnit::restore(CheckpointReader& in) {
+    return in.read(freeCycle);
+}
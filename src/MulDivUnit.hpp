@@ -0,0 +1,103 @@
+#ifndef MUL_DIV_UNIT_HPP
+#define MUL_DIV_UNIT_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Checkpoint.hpp"
+
+using namespace std;
+
+// Latencies of the M-extension operations, e.g. "3:20" or "4:34:34:iterative"
+// (mul:div[:rem][:pipelined|iterative]). A latency counts the cycles from the
+// operation entering EX to a dependent instruction being able to use its
+// result in EX, so 1 is the timing of an add. By default the multiplier is
+// pipelined and the divider (which also computes rem) iterative.
+struct MulDivConfig {
+    uint32_t mulLatency = 1;
+    uint32_t divLatency = 1;
+    uint32_t remLatency = 1;
+    bool mulPipelined = true;  // Takes a new operation every cycle
+    bool divPipelined = false; // Otherwise one operation at a time
+
+    // Parse the string form; returns false on malformed values
+    static bool parse(const string& text, MulDivConfig& config);
+    string describe() const;
+};
+
+// Multiplier and divider beside EX. An operation with a latency above 1
+// leaves EX after one cycle like any other instruction, but without writing
+// rd: the unit writes its result to the register file itself, at the end of
+// WB in the cycle it is ready. Until then the scoreboard (pending) holds in
+// ID every instruction that reads or writes that register, and an iterative
+// unit holds the next operation for it until it is free.
+class MulDivUnit {
+public:
+    // Value of an operation that the unit writes to rd in the WB phase of readyCycle
+    struct Result {
+        uint32_t rd = 0;
+        int32_t value = 0;
+        int32_t readyCycle = 0;
+    };
+
+    explicit MulDivUnit(const MulDivConfig& config) : config(config) {}
+
+    // Latency of the operation with this ALU control (11-13, 16-20); 0 for
+    // any other operation, which EX completes as usual
+    uint32_t latency(uint32_t aluControl) const;
+    bool isMultiCycle(uint32_t aluControl) const { return latency(aluControl) > 1; }
+    // mul, mulh, mulhsu and mulhu run on the multiplier, the rest on the divider
+    static bool isMultiply(uint32_t aluControl) { return aluControl == 11 || (aluControl >= 16 && aluControl <= 18); }
+    // The unit executing aluControl can start it in `cycle`
+    bool canIssue(uint32_t aluControl, int cycle) const;
+    // The operations with ALU controls a and b use the same iterative unit
+    bool sharesIterativeUnit(uint32_t a, uint32_t b) const;
+    // Start aluControl in `cycle`; value is written to rd in the WB phase of readyCycle
+    void issue(uint32_t aluControl, int cycle, uint32_t rd, int32_t value, int readyCycle);
+    // Count aluControl under multiplies, divides or remainders
+    void countOperation(uint32_t aluControl);
+    // Results not written yet, in issue order; a checkpoint keeps them with
+    // the architectural state and schedule() puts them back
+    const vector<Result>& pendingResults() const { return inFlight; }
+    void schedule(const Result& result) { inFlight.push_back(result); }
+    // Register rd waits for a result that is written after `cycle`
+    bool pending(uint32_t rd, int cycle) const;
+    // Write the results that are ready in `cycle` with write(rd, value), in issue order
+    template <typename Write>
+    void complete(int cycle, Write write) {
+        size_t kept = 0;
+        for (const Result& result : inFlight) {
+            if (result.readyCycle <= cycle) {
+                write(result.rd, result.value);
+            } else {
+                inFlight[kept++] = result;
+            }
+        }
+        inFlight.resize(kept);
+    }
+    // No result waits to be written
+    bool idle() const { return inFlight.empty(); }
+    // Drop the operations in flight and clear the counters
+    void clear();
+    // Which iterative units are busy (not the results or the counters)
+    void save(CheckpointWriter& out) const;
+    bool restore(CheckpointReader& in);
+
+    const MulDivConfig& getConfig() const { return config; }
+
+    uint64_t multiplies = 0;
+    uint64_t divides = 0;
+    uint64_t remainders = 0;
+
+private:
+    enum Kind { MULTIPLIER, DIVIDER, kUnits };
+
+    static Kind kind(uint32_t aluControl) { return isMultiply(aluControl) ? MULTIPLIER : DIVIDER; }
+    bool pipelined(Kind unit) const { return unit == MULTIPLIER ? config.mulPipelined : config.divPipelined; }
+
+    MulDivConfig config;
+    vector<Result> inFlight;
+    int32_t freeCycle[kUnits] = {}; // Iterative unit: first cycle it can start an operation
+};
+
+#endif // MUL_DIV_UNIT_HPP
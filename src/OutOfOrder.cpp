@@ -0,0 +1,534 @@
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include "Processor.hpp"
+
+namespace {
+// Bytes a load/store with this funct3 accesses
+uint32_t accessSize(uint32_t funct3) {
+    switch (funct3 & 0x3) {
+    case 0x0: return 1; // LB/LBU/SB
+    case 0x1: return 2; // LH/LHU/SH
+    default: return 4;  // LW/SW
+    }
+}
+
+// Value a load with this funct3 reads from the low bytes of data
+int32_t extendLoad(uint32_t data, uint32_t funct3) {
+    switch (funct3) {
+    case 0x0: return static_cast<int8_t>(data);   // LB
+    case 0x1: return static_cast<int16_t>(data);  // LH
+    case 0x4: return static_cast<uint8_t>(data);  // LBU
+    case 0x5: return static_cast<uint16_t>(data); // LHU
+    default: return static_cast<int32_t>(data);   // LW
+    }
+}
+
+// Instructions fetched ahead of rename, in fetch groups
+const uint32_t kFetchQueueGroups = 2;
+} // namespace
+
+bool OutOfOrderConfig::parse(const string& text, OutOfOrderConfig& config) {
+    vector<uint32_t> fields;
+    istringstream in(text);
+    string field;
+    try {
+        while (getline(in, field, ':')) {
+            if (field.empty() || field[0] == '-') return false;
+            fields.push_back(stoul(field));
+        }
+    } catch (const exception&) {
+        return false;
+    }
+    if (fields.size() < 4 || fields.size() > 5) return false;
+    config.robEntries = fields[0];
+    config.issueQueueEntries = fields[1];
+    config.loadStoreEntries = fields[2];
+    config.width = fields[3];
+    config.physicalRegisters = fields.size() > 4 ? fields[4] : 0;
+    for (size_t i = 0; i < 3; i++) {
+        if (fields[i] == 0 || fields[i] > kMaxEntries) return false;
+    }
+    // Renaming needs a free register beyond the architectural ones
+    return config.width > 0 && config.width <= kMaxWidth &&
+           (fields.size() < 5 || (config.physicalRegisters > 32 && config.physicalRegisters <= 32 + kMaxEntries));
+}
+
+string OutOfOrderConfig::describe() const {
+    ostringstream out;
+    out << robEntries << ":" << issueQueueEntries << ":" << loadStoreEntries << ":" << width << ":" << registers();
+    return out.str();
+}
+
+OutOfOrderCore::OutOfOrderCore(Processor& processor, const OutOfOrderConfig& config)
+    : processor(processor), config(config), rob(config.robEntries) {
+    reset();
+}
+
+void OutOfOrderCore::reset() {
+    stats = OutOfOrderStats();
+    stats.issued.assign(config.width + 1, 0);
+    started = false;
+    fetchQueue.clear();
+    issueQueue.clear();
+    robHead = 0;
+    robCount = 0;
+    loadStoreCount = 0;
+    unitFree[0] = unitFree[1] = 0;
+    writeFree = 0;
+}
+
+void OutOfOrderCore::start() {
+    // Every architectural register in the physical register of the same number
+    values.assign(config.registers(), 0);
+    readyCycle.assign(config.registers(), kNever);
+    for (uint32_t reg = 0; reg < 32; reg++) {
+        renameMap[reg] = reg;
+        values[reg] = processor.getRegister(reg);
+        readyCycle[reg] = numeric_limits<int>::min();
+    }
+    freeList.clear();
+    for (uint32_t reg = config.registers(); reg-- > 32;) {
+        freeList.push_back(reg);
+    }
+    fetchPC = processor.getPC();
+    fetchStopped = false;
+    fetchLookedUp = false;
+    fetchWaitCycles = 0;
+    started = true;
+}
+
+bool OutOfOrderCore::finished() const {
+    if (!started) {
+        return processor.haltRequested || processor.getDecoded(processor.getPC()).instruction == 0;
+    }
+    return empty() && (processor.haltRequested || fetchStopped);
+}
+
+uint64_t OutOfOrderCore::oldestInFlight() const {
+    if (robCount > 0) return rob[robHead].seq;
+    if (!fetchQueue.empty()) return fetchQueue.front().seq;
+    return processor.fetchSeq;
+}
+
+OutOfOrderCore::Kind OutOfOrderCore::classify(const DecodedInstruction& decoded) const {
+    switch (decoded.opcode) {
+    case 0b0110011: // R-type
+        return processor.mulDivUnit && processor.mulDivUnit->isMultiCycle(decoded.aluControl) ? MULDIV : ALU;
+    case 0b0010011: // I-type ALU
+    case 0b0110111: // LUI
+    case 0b0010111: // AUIPC
+        return ALU;
+    case 0b0000011: return LOAD;
+    case 0b0100011: return STORE;
+    case 0b1100011: return BRANCH;
+    case 0b1101111: // JAL
+    case 0b1100111: // JALR
+        return JUMP;
+    default:
+        return SYSTEM;
+    }
+}
+
+void OutOfOrderCore::cycle(int i) {
+    if (!started) start();
+    // Oldest work first, as in the pipeline: what commits frees entries for
+    // rename, and an issue that squashes redirects the fetch of this cycle
+    commit(i);
+    markInFlight(i);
+    issue(i);
+    rename(i);
+    fetch(i);
+
+    stats.robOccupancy += robCount;
+    stats.robPeak = max(stats.robPeak, robCount);
+    if (robCount == config.robEntries) stats.robFullCycles++;
+    stats.issueQueueOccupancy += issueQueue.size();
+    stats.loadStoreOccupancy += loadStoreCount;
+}
+
+void OutOfOrderCore::commit(int i) {
+    uint32_t committed = 0;
+    while (committed < config.width && robCount > 0) {
+        Entry& entry = rob[robHead];
+        const DecodedInstruction& decoded = *entry.decoded;
+        if (entry.readyCycle > i || (entry.kind == STORE && (!ready(entry.rs2, i) || writeFree > i))) {
+            break;
+        }
+        if (entry.kind == STORE) {
+            // The write goes to the data cache; a miss only holds the next store
+            uint32_t wait = processor.dataCache ? processor.dataCache->access(entry.address, true) : 0;
+            processor.stats.memoryStalls += wait;
+            writeFree = i + 1 + wait;
+            processor.storeData(entry.address, decoded.funct3, values[entry.rs2]);
+        }
+        processor.markStage(entry.pc, entry.seq, i, PipelineTrace::WB);
+
+        if (entry.rd != 0) {
+            processor.setRegister(decoded.rd, values[entry.rd]);
+            freeList.push_back(entry.previous);
+        }
+        if (entry.kind == BRANCH || entry.kind == JUMP) {
+            bool conditional = entry.kind == BRANCH;
+            if (conditional) {
+                processor.stats.branches++;
+                if (entry.taken) processor.stats.takenBranches++;
+            } else {
+                processor.stats.jumps++;
+            }
+            if (entry.mispredicted) processor.stats.mispredictions++;
+            if (processor.branchPredictor) {
+                uint32_t target = conditional ? entry.pc + decoded.immediate : entry.nextPC;
+                processor.branchPredictor->update(entry.pc, conditional, !conditional || entry.taken, target);
+            }
+        }
+        if (entry.kind == MULDIV) {
+            processor.mulDivUnit->countOperation(decoded.aluControl);
+        }
+        if (entry.kind == LOAD || entry.kind == STORE) loadStoreCount--;
+        processor.setPC(entry.nextPC);
+        processor.stats.retired++;
+        if (committed > 0) processor.stats.coRetired++;
+        committed++;
+        robHead = robIndex(1);
+        robCount--;
+        if (decoded.opcode == 0b1110011) {
+            // ecall/ebreak: fetch stopped behind it, so nothing younger is in flight
+            processor.haltRequested = true;
+            break;
+        }
+    }
+    if (committed > 0) return;
+
+    OutOfOrderStats::Wait wait = OutOfOrderStats::EMPTY;
+    if (robCount > 0) {
+        const Entry& head = rob[robHead];
+        if (!head.issued) {
+            wait = OutOfOrderStats::OPERANDS;
+        } else if (head.kind == LOAD) {
+            wait = OutOfOrderStats::LOAD;
+        } else if (head.kind == STORE) {
+            wait = ready(head.rs2, i) ? OutOfOrderStats::STORE : OutOfOrderStats::OPERANDS;
+        } else if (head.kind == MULDIV) {
+            wait = OutOfOrderStats::MULDIV;
+        } else {
+            wait = OutOfOrderStats::OPERANDS;
+        }
+    }
+    stats.commitStalls[wait]++;
+}
+
+void OutOfOrderCore::markInFlight(int i) {
+    // Loads and stores after the cycle they issued in are in MEM until they
+    // are ready; a multi-cycle operation stays in EX
+    for (uint32_t offset = 0; offset < robCount; offset++) {
+        const Entry& entry = rob[robIndex(offset)];
+        if (!entry.issued || entry.readyCycle <= i) continue;
+        bool memory = entry.kind == LOAD || entry.kind == STORE;
+        processor.markStage(entry.pc, entry.seq, i, memory ? PipelineTrace::MEM : PipelineTrace::EX);
+    }
+}
+
+void OutOfOrderCore::issue(int i) {
+    uint32_t issued = 0;
+    bool loadIssued = false; // One data cache read port
+    size_t kept = 0;
+    size_t position = 0;
+    for (; position < issueQueue.size() && issued < config.width; position++) {
+        uint32_t index = issueQueue[position];
+        Kind kind = rob[index].kind;
+        uint32_t inFlight = robCount;
+        if ((kind == LOAD && loadIssued) || !execute(index, i)) {
+            issueQueue[kept++] = index;
+            continue;
+        }
+        issued++;
+        if (kind == LOAD) loadIssued = true;
+        if (robCount < inFlight) {
+            // A misprediction; the queue is in age order, so everything
+            // after it has been squashed
+            position = issueQueue.size();
+            break;
+        }
+    }
+    for (; position < issueQueue.size(); position++) {
+        issueQueue[kept++] = issueQueue[position];
+    }
+    issueQueue.resize(kept);
+    stats.issued[issued]++;
+}
+
+bool OutOfOrderCore::loadValue(uint32_t index, int i, int32_t& value, bool& forwarded) const {
+    const Entry& load = rob[index];
+    uint32_t size = accessSize(load.decoded->funct3);
+    // The youngest older store touching the same bytes decides
+    for (uint32_t k = index; k != robHead;) {
+        k = (k + config.robEntries - 1) % config.robEntries;
+        const Entry& store = rob[k];
+        if (store.kind != STORE) continue;
+        if (!store.issued) return false; // Address unknown
+        uint32_t storeSize = accessSize(store.decoded->funct3);
+        if (store.address + storeSize <= load.address || load.address + size <= store.address) continue;
+        if (store.address != load.address || storeSize < size || !ready(store.rs2, i)) {
+            return false; // Partly covered, or its data is not there yet
+        }
+        value = extendLoad(values[store.rs2], load.decoded->funct3);
+        forwarded = true;
+        return true;
+    }
+    value = processor.loadData(load.address, load.decoded->funct3);
+    forwarded = false;
+    return true;
+}
+
+bool OutOfOrderCore::execute(uint32_t index, int i) {
+    Entry& entry = rob[index];
+    const DecodedInstruction& decoded = *entry.decoded;
+    if (!ready(entry.rs1, i) || (entry.kind != STORE && !ready(entry.rs2, i))) {
+        return false;
+    }
+    int32_t readData1 = values[entry.rs1];
+    int32_t readData2 = values[entry.rs2];
+    // Load/store/jalr address, wrapping rather than overflowing int32_t
+    uint32_t address = static_cast<uint32_t>(readData1) + static_cast<uint32_t>(decoded.immediate);
+    int32_t result = 0;
+    uint32_t latency = 1;
+    bool zero = false;
+
+    switch (entry.kind) {
+    case ALU:
+    case MULDIV:
+        if (decoded.opcode == 0b0110111) { // LUI
+            result = decoded.immediate;
+        } else if (decoded.opcode == 0b0010111) { // AUIPC
+            result = entry.pc + decoded.immediate;
+        } else {
+            result = Execute::performALU(decoded.aluControl, readData1,
+                decoded.signals.aluSrc ? decoded.immediate : readData2, zero);
+        }
+        if (entry.kind == MULDIV) {
+            const MulDivUnit& unit = *processor.mulDivUnit;
+            latency = unit.latency(decoded.aluControl);
+            bool multiply = MulDivUnit::isMultiply(decoded.aluControl);
+            int& free = unitFree[multiply ? 0 : 1];
+            bool pipelined = multiply ? unit.getConfig().mulPipelined : unit.getConfig().divPipelined;
+            if (!pipelined) {
+                if (free > i) return false;
+                free = i + latency;
+            }
+        }
+        break;
+    case LOAD: {
+        entry.address = address;
+        bool forwarded = false;
+        if (!loadValue(index, i, result, forwarded)) {
+            stats.loadOrderStalls++;
+            return false;
+        }
+        // Address in the cycle it issues, then the memory stage
+        latency = 2;
+        if (forwarded) {
+            stats.forwardedLoads++;
+        } else if (processor.dataCache) {
+            uint32_t wait = processor.dataCache->access(entry.address, false);
+            processor.stats.memoryStalls += wait;
+            latency += wait;
+        }
+        break;
+    }
+    case STORE:
+        // The address now; the data is read when the store commits
+        entry.address = address;
+        latency = 2;
+        break;
+    case BRANCH:
+        entry.taken = InstructionDecode::branchTaken(decoded.funct3, readData1, readData2);
+        entry.nextPC = entry.taken ? entry.pc + decoded.immediate : entry.pc + 4;
+        break;
+    case JUMP:
+        result = entry.pc + 4;
+        entry.nextPC = decoded.opcode == 0b1101111 ? entry.pc + decoded.immediate
+                                                   : address & ~1u;
+        break;
+    case SYSTEM:
+        break;
+    }
+    entry.issued = true;
+    entry.readyCycle = i + latency;
+    if (entry.rd != 0) {
+        values[entry.rd] = result;
+        readyCycle[entry.rd] = i + latency;
+    }
+    processor.markStage(entry.pc, entry.seq, i, PipelineTrace::EX);
+    if ((entry.kind == BRANCH || entry.kind == JUMP) && entry.nextPC != entry.predictedNext) {
+        entry.mispredicted = true;
+        squashAfter(index, entry.nextPC);
+    }
+    return true;
+}
+
+void OutOfOrderCore::squashAfter(uint32_t index, uint32_t target) {
+    // Undo the renames youngest first, so every map entry ends up as it was
+    // when the instruction after index was renamed
+    while (robCount > 0 && robIndex(robCount - 1) != index) {
+        Entry& entry = rob[robIndex(robCount - 1)];
+        if (entry.rd != 0) {
+            renameMap[entry.decoded->rd] = entry.previous;
+            readyCycle[entry.rd] = kNever;
+            freeList.push_back(entry.rd);
+        }
+        if (entry.kind == LOAD || entry.kind == STORE) loadStoreCount--;
+        processor.stats.flushes++;
+        robCount--;
+    }
+    redirect(target);
+}
+
+void OutOfOrderCore::redirect(uint32_t target) {
+    processor.stats.flushes += fetchQueue.size();
+    fetchQueue.clear();
+    fetchPC = target;
+    fetchStopped = false;
+    fetchLookedUp = false;
+    fetchWaitCycles = 0;
+}
+
+void OutOfOrderCore::rename(int i) {
+    if (fetchQueue.empty() || fetchQueue.front().fetchCycle >= i) {
+        if (!fetchStopped) stats.frontendStalls++;
+        return;
+    }
+    for (uint32_t renamed = 0; renamed < config.width && !fetchQueue.empty(); renamed++) {
+        Entry& entry = fetchQueue.front();
+        if (entry.fetchCycle >= i) break;
+        const DecodedInstruction& decoded = *entry.decoded;
+        bool writes = decoded.signals.regWrite && decoded.rd != 0;
+        bool memory = entry.kind == LOAD || entry.kind == STORE;
+        HazardType full = HazardType::NONE;
+        if (robCount == config.robEntries) {
+            full = HazardType::ROB_FULL;
+        } else if (entry.kind != SYSTEM && issueQueue.size() == config.issueQueueEntries) {
+            full = HazardType::ISSUE_QUEUE_FULL;
+        } else if (memory && loadStoreCount == config.loadStoreEntries) {
+            full = HazardType::LSQ_FULL;
+        } else if (writes && freeList.empty()) {
+            full = HazardType::NO_FREE_REGISTER;
+        }
+        if (full != HazardType::NONE) {
+            processor.countStall(full, entry.pc, entry.seq);
+            break;
+        }
+
+        // Sources through the map as it is before this instruction's rd
+        switch (decoded.opcode) {
+        case 0b0110011: // R-type
+        case 0b0100011: // Store
+        case 0b1100011: // Branch
+            entry.rs2 = renameMap[decoded.rs2];
+            entry.rs1 = renameMap[decoded.rs1];
+            break;
+        case 0b0010011: // I-type ALU
+        case 0b0000011: // Load
+        case 0b1100111: // JALR
+            entry.rs1 = renameMap[decoded.rs1];
+            break;
+        default:
+            break; // LUI, AUIPC and JAL read no register
+        }
+        if (writes) {
+            entry.rd = freeList.back();
+            freeList.pop_back();
+            entry.previous = renameMap[decoded.rd];
+            renameMap[decoded.rd] = entry.rd;
+            readyCycle[entry.rd] = kNever;
+        }
+        entry.nextPC = entry.pc + 4;
+        processor.markStage(entry.pc, entry.seq, i, PipelineTrace::ID);
+        uint32_t index = robIndex(robCount);
+        rob[index] = entry;
+        robCount++;
+        if (entry.kind == SYSTEM) {
+            rob[index].readyCycle = i + 1;
+        } else {
+            issueQueue.push_back(index);
+        }
+        if (memory) loadStoreCount++;
+        fetchQueue.pop_front();
+        if (decoded.opcode == 0b1101111 && rob[index].predictedNext != rob[index].pc + decoded.immediate) {
+            // The target of a jal is known once it is decoded: fetch goes
+            // there from the next cycle, and EX finds it predicted
+            rob[index].predictedNext = rob[index].pc + decoded.immediate;
+            rob[index].mispredicted = true;
+            redirect(rob[index].predictedNext);
+            break;
+        }
+    }
+    // The rest are in ID until they are renamed
+    for (const Entry& entry : fetchQueue) {
+        if (entry.fetchCycle < i) processor.markStage(entry.pc, entry.seq, i, PipelineTrace::ID);
+    }
+}
+
+void OutOfOrderCore::fetch(int i) {
+    if (fetchStopped) return;
+    uint32_t capacity = kFetchQueueGroups * config.width;
+    if (fetchQueue.size() >= capacity) return;
+    Cache* cache = processor.instructionCache.get();
+    if (cache) {
+        // One access fetches the group, which ends at the line
+        if (!fetchLookedUp) {
+            fetchWaitCycles = cache->access(fetchPC, false);
+            fetchLookedUp = true;
+        }
+        if (fetchWaitCycles > 0) {
+            fetchWaitCycles--;
+            processor.stats.fetchStalls++;
+            return;
+        }
+    }
+    for (uint32_t fetched = 0; fetched < config.width && fetchQueue.size() < capacity; fetched++) {
+        const DecodedInstruction& decoded = processor.getDecoded(fetchPC);
+        if (decoded.instruction == 0) {
+            fetchStopped = true; // Until a redirect, or for good on the committed path
+            break;
+        }
+        Entry entry;
+        entry.seq = processor.fetchSeq++;
+        entry.pc = fetchPC;
+        entry.decoded = &decoded;
+        entry.kind = classify(decoded);
+        entry.fetchCycle = i;
+        entry.predictedNext = processor.branchPredictor ? processor.branchPredictor->predictNext(fetchPC) : fetchPC + 4;
+        fetchQueue.push_back(entry);
+        processor.markStage(entry.pc, entry.seq, i, PipelineTrace::IF);
+        fetchPC = entry.predictedNext;
+        if (decoded.opcode == 0b1110011) {
+            fetchStopped = true; // ecall/ebreak ends the program once it commits
+            break;
+        }
+        if (fetchPC != entry.pc + 4 || (cache && fetchPC % cache->getConfig().lineSize == 0)) {
+            break; // Predicted taken, or the end of the cache line
+        }
+    }
+    fetchLookedUp = false;
+}
+
+void OutOfOrderCore::writeStats(ostream& out) const {
+    uint64_t cycles = processor.stats.cycles;
+    auto mean = [&](uint64_t sum) { return cycles ? double(sum) / cycles : 0.0; };
+    static const char* const kWaitNames[OutOfOrderStats::kWaits] = { "empty", "operands", "load", "store", "muldiv" };
+    out << "  \"ooo\": {\"config\": \"" << config.describe() << "\", \"ipc\": " << mean(processor.stats.retired)
+        << ", \"rob\": {\"entries\": " << config.robEntries << ", \"mean\": " << mean(stats.robOccupancy)
+        << ", \"peak\": " << stats.robPeak << ", \"full_cycles\": " << stats.robFullCycles << "}"
+        << ", \"issue_queue_mean\": " << mean(stats.issueQueueOccupancy)
+        << ", \"lsq_mean\": " << mean(stats.loadStoreOccupancy) << ", \"issued\": [";
+    for (size_t count = 0; count < stats.issued.size(); count++) {
+        out << (count ? ", " : "") << stats.issued[count];
+    }
+    out << "], \"frontend_stalls\": " << stats.frontendStalls << ", \"commit_stalls\": {";
+    for (int wait = 0; wait < OutOfOrderStats::kWaits; wait++) {
+        out << (wait ? ", " : "") << "\"" << kWaitNames[wait] << "\": " << stats.commitStalls[wait];
+    }
+    out << "}, \"loads\": {\"forwarded\": " << stats.forwardedLoads
+        << ", \"order_stalls\": " << stats.loadOrderStalls << "}},\n";
+}
@@ -0,0 +1,194 @@
+#ifndef OUT_OF_ORDER_HPP
+#define OUT_OF_ORDER_HPP
+
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class Processor;
+struct DecodedInstruction;
+
+// Sizes of the out-of-order core, e.g. "32:16:16:2" or "64:32:16:4:80"
+// (rob:issue queue:load/store queue:width[:physical registers]). The width
+// applies to fetch, rename, issue and commit alike. By default there are as
+// many physical registers beyond the 32 architectural ones as ROB entries,
+// so renaming never runs out of registers before the ROB fills.
+struct OutOfOrderConfig {
+    static constexpr uint32_t kMaxWidth = 8;
+    static constexpr uint32_t kMaxEntries = 1024; // Per structure
+
+    uint32_t robEntries = 32;
+    uint32_t issueQueueEntries = 16;
+    uint32_t loadStoreEntries = 16;
+    uint32_t width = 2;
+    uint32_t physicalRegisters = 0; // 0: 32 + robEntries
+
+    // Parse the string form; returns false on malformed values
+    static bool parse(const string& text, OutOfOrderConfig& config);
+    string describe() const;
+    uint32_t registers() const { return physicalRegisters ? physicalRegisters : 32 + robEntries; }
+};
+
+// Counters of the out-of-order core that PipelineStats has no place for
+struct OutOfOrderStats {
+    // What the oldest instruction waits for in a cycle in which nothing commits
+    enum Wait {
+        EMPTY,    // The ROB is empty: the front end has not delivered
+        OPERANDS, // Not issued yet: its operands or an issue slot
+        LOAD,     // A load in the memory stage (cache miss, or an older store's data)
+        STORE,    // A store waiting for its address, or for the write of the store before it
+        MULDIV,   // A multi-cycle mul/div/rem
+        kWaits
+    };
+
+    uint64_t robOccupancy = 0;        // Sum over the cycles of the ROB entries in use
+    uint32_t robPeak = 0;
+    uint64_t robFullCycles = 0;
+    uint64_t issueQueueOccupancy = 0; // Same for the issue queue
+    uint64_t loadStoreOccupancy = 0;  // ... and the load/store queue
+    vector<uint64_t> issued;          // Cycles in which 0, 1, ... width instructions issued
+    uint64_t frontendStalls = 0;      // Cycles rename found no fetched instruction
+    uint64_t commitStalls[kWaits] = {};
+    uint64_t forwardedLoads = 0;      // Loads given their value by an older store in the queue
+    uint64_t loadOrderStalls = 0;     // Cycles a load with its operand ready waited for an older store
+};
+
+// Out-of-order backend replacing the five-stage pipeline of a Processor
+// (see Processor::setOutOfOrder). Instructions are fetched in order along
+// the predicted path, renamed onto a physical register file and placed in
+// the reorder buffer, and in the issue queue and, for loads and stores, the
+// load/store queue. They issue oldest first once their operands are ready,
+// compute their results with the decoded records and the ALU of the
+// pipeline, and commit in order, writing the Processor's registers; so the
+// Processor always holds the architectural state of the committed
+// instructions.
+//
+// A branch or jump whose resolved next pc differs from the one fetched
+// after it squashes every younger instruction, restores the rename map
+// from the squashed entries and redirects fetch; a jal does so in rename,
+// before anything younger has been renamed. Stores write memory when
+// they commit, one a cycle, and a write that misses in the data cache
+// holds the next store's commit for the miss cycles. A load waits until
+// every older store has its address, then takes the value of the youngest
+// older store to the same bytes if that store covers it, and otherwise
+// waits for the overlapping store to commit or reads memory through the
+// data cache.
+//
+// Timing: fetch, rename and issue each take a cycle; an ALU result, a
+// branch or a jump is ready one cycle after issue, a load two plus the
+// cache miss cycles, a mul/div/rem after its --muldiv latency. The diagram
+// shows IF, ID while an instruction waits to be renamed, EX when it issues
+// (and while a multi-cycle operation runs), MEM while a load or store is in
+// the memory stage and WB when it commits.
+class OutOfOrderCore {
+public:
+    OutOfOrderCore(Processor& processor, const OutOfOrderConfig& config);
+
+    // Drop every instruction in flight and clear the counters; the next
+    // cycle starts from the Processor's registers and pc
+    void reset();
+    // Simulate cycle i
+    void cycle(int i);
+    // Fetch has stopped (ecall/ebreak committed, or pc left the program)
+    // and no instruction is in flight
+    bool finished() const;
+    // No instruction fetched and not yet committed
+    bool empty() const { return robCount == 0 && fetchQueue.empty(); }
+    // Smallest dynamic number still in flight
+    uint64_t oldestInFlight() const;
+
+    const OutOfOrderConfig& getConfig() const { return config; }
+    const OutOfOrderStats& getStats() const { return stats; }
+    // The "ooo" member of Processor::writeStats
+    void writeStats(ostream& out) const;
+
+private:
+    // What an instruction needs from the backend
+    enum Kind : uint8_t {
+        ALU,      // Also lui/auipc
+        MULDIV,   // mul/div/rem with a latency above 1
+        LOAD,
+        STORE,
+        BRANCH,
+        JUMP,     // jal/jalr
+        SYSTEM    // ecall/ebreak or an unknown instruction: nothing to execute
+    };
+    static constexpr int kNever = 0x7FFFFFFF;
+
+    // An instruction from fetch to commit
+    struct Entry {
+        uint64_t seq = 0;
+        uint32_t pc = 0;
+        const DecodedInstruction* decoded = nullptr;
+        Kind kind = SYSTEM;
+        int fetchCycle = 0;
+        uint32_t predictedNext = 0; // Address fetched after it
+        uint32_t nextPC = 0;        // Resolved when it executes
+        bool taken = false;         // Conditional branch
+        bool mispredicted = false;  // Fetch was redirected behind it
+        // Physical registers: result (0 for none), the one rd was mapped to
+        // before, and the sources (0, x0, when unused)
+        uint32_t rd = 0;
+        uint32_t previous = 0;
+        uint32_t rs1 = 0;
+        uint32_t rs2 = 0;
+        uint32_t address = 0;       // Load/store, once issued
+        bool issued = false;
+        int readyCycle = kNever;    // First cycle it can commit
+    };
+
+    void commit(int i);
+    void markInFlight(int i);
+    void issue(int i);
+    void rename(int i);
+    void fetch(int i);
+    void start();
+
+    Kind classify(const DecodedInstruction& decoded) const;
+    // Execute the entry in ROB position index; false when it cannot issue this cycle
+    bool execute(uint32_t index, int i);
+    // Load in ROB position index: false while an older store keeps it from
+    // reading; otherwise value is what it reads and forwarded whether it
+    // came from a store in the queue
+    bool loadValue(uint32_t index, int i, int32_t& value, bool& forwarded) const;
+    // Drop every instruction younger than ROB position index and fetch from
+    // target; the issue queue is left to the caller
+    void squashAfter(uint32_t index, uint32_t target);
+    // Drop the instructions fetched but not renamed yet and fetch from target
+    void redirect(uint32_t target);
+    bool ready(uint32_t reg, int i) const { return readyCycle[reg] <= i; }
+    uint32_t robIndex(uint32_t offset) const { return (robHead + offset) % config.robEntries; }
+
+    Processor& processor;
+    OutOfOrderConfig config;
+    OutOfOrderStats stats;
+    bool started = false;
+
+    // Front end
+    uint32_t fetchPC = 0;
+    bool fetchStopped = false;   // At an ecall/ebreak or outside the program until a redirect
+    bool fetchLookedUp = false;  // The instruction cache has been looked up for the group at fetchPC
+    uint32_t fetchWaitCycles = 0;
+    deque<Entry> fetchQueue;     // Fetched, not renamed yet
+
+    // Rename
+    uint32_t renameMap[32] = {};
+    vector<int32_t> values;      // Physical register file
+    vector<int> readyCycle;      // First cycle each physical register can be read
+    vector<uint32_t> freeList;
+
+    // Reorder buffer (a ring of robEntries), issue queue (ROB positions, oldest first)
+    vector<Entry> rob;
+    uint32_t robHead = 0;
+    uint32_t robCount = 0;
+    vector<uint32_t> issueQueue;
+    uint32_t loadStoreCount = 0; // Loads and stores in the ROB
+    int unitFree[2] = {};        // Iterative multiplier, divider: first cycle they take an operation
+    int writeFree = 0;           // First cycle the data cache takes a store's write
+};
+
+#endif // OUT_OF_ORDER_HPP
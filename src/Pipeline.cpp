@@ -0,0 +1,1314 @@
+#include <iostream>
+#include <fstream>  //Provides file handling classes: ifstream (input), ofstream (output), and fstream (both).
+#include <sstream>  //error fixed //Provides stringstream, istringstream, and ostringstream for string manipulation.
+#include <vector>
+#include <cstdint>  //Defines fixed-width integer types like int8_t, uint16_t, int32_t, uint64_t.
+#include <iomanip>  //Provides manipulators like std::setw, std::setprecision, std::fixed, std::hex, etc.
+#include <chrono>
+#include "Pipeline.hpp"
+using namespace std;
+
+
+template <typename Policy>
+void InstructionFetch::process(const int i) {
+    // Fetch stages after the first (see PipelineDepth), oldest last
+    vector<IF_ID_Register>& line = processor->getFetchLine();
+    if (processor->haltRequested) {
+        // Nothing is fetched after ecall/ebreak; the pipeline drains
+        processor->getIF_ID() = IF_ID_Register();
+        if (Policy::kGeneral) {
+            fill(line.begin(), line.end(), IF_ID_Register());
+        }
+        return;
+    }
+    for (size_t stage = 0; Policy::kGeneral && stage < line.size(); stage++) {
+        if (line[stage].instruction) {
+            processor->markStage(line[stage].pc, line[stage].seq, i, PipelineTrace::IF | PipelineTrace::subStage(stage + 1));
+        }
+    }
+    if (processor->drainRequested) {
+        // Nothing more is fetched, but pc follows the instructions in flight
+        // so that it ends at the next instruction to execute
+        if (!processor->memBusy && !Policy::fetchStalled(*processor)) {
+            processor->advanceFetch<Policy::kGeneral>() = IF_ID_Register();
+        }
+        if (processor->isBranchTaken()) {
+            processor->stats.flushes += squashFetched<Policy>(false);
+            processor->setPC(processor->getBranchTarget());
+            processor->setBranch(false, 0);
+        }
+        processor->fetchAccessStarted = false;
+        processor->fetchWaitCycles = 0;
+        return;
+    }
+    if (Policy::kCheckPCAlignment && (processor->getPC()) % 4 != 0) {
+        processor->fetchFault = true;
+        return;
+    }
+    if (processor->instructionRow(processor->getPC()) < processor->getnoofinstructions()) {
+        // Update pipeline matrix display
+        processor->markStage(processor->getPC(), processor->fetchSeq, i, PipelineTrace::IF);
+    }
+    if (processor->memBusy || Policy::fetchStalled(*processor)) {
+        return;
+    }
+    // A redirect keeps the instruction about to enter ID if it is the target
+    // (and with it those fetched after it); otherwise it squashes everything
+    // fetched so far, including what is fetched now
+    bool redirect = processor->isBranchTaken();
+    uint32_t target = processor->getBranchTarget();
+    bool unsplit = !Policy::kGeneral || line.empty();
+    bool keepLine = Policy::kKeepFetchAtTarget && redirect && !unsplit &&
+        line.back().instruction && line.back().pc == target;
+    bool squashed = redirect && (unsplit ? processor->getPC() != target : !keepLine);
+    // An instruction cache miss keeps IF on this pc until the line has been
+    // filled, with no-ops going to ID meanwhile. A fetch that a taken branch
+    // squashes anyway does not look up the cache.
+    if (processor->instructionCache && processor->instructionRow(processor->getPC()) < processor->getnoofinstructions() &&
+        !squashed) {
+        if (!processor->fetchAccessStarted) {
+            processor->fetchWaitCycles = processor->instructionCache->access(processor->getPC(), false);
+            processor->fetchAccessStarted = true;
+        }
+        if (processor->fetchWaitCycles > 0) {
+            processor->fetchWaitCycles--;
+            processor->stats.fetchStalls++;
+            processor->advanceFetch<Policy::kGeneral>() = IF_ID_Register();
+            if (keepLine) {
+                processor->setBranch(false, 0);
+            }
+            return;
+        }
+        processor->fetchAccessStarted = false;
+    }
+    // Fetch instruction at current PC
+    uint32_t fetchPC = processor->getPC();
+    const DecodedInstruction& decoded = processor->getDecoded(fetchPC);
+    uint32_t nextPC = processor->branchPredictor ? processor->branchPredictor->predictNext(fetchPC) : fetchPC + 4;
+    // Past the program (e.g. at the return sentinel) pc stays put while the
+    // pipeline drains, however long that takes, rather than wrap to 0
+    if (decoded.instruction == 0) {
+        nextPC = fetchPC;
+    }
+    IF_ID_Register& fetched = processor->advanceFetch<Policy::kGeneral>();
+    fetched.instruction = decoded.instruction;
+    fetched.decoded = &decoded;
+    fetched.pc = fetchPC;
+    fetched.predictedNext = nextPC;
+    fetched.seq = processor->fetchSeq++;
+    fetched.isStall = false;
+    processor->setPC(nextPC);
+
+    // The instruction just fetched is the branch target: keep it
+    if (Policy::kKeepFetchAtTarget && redirect && (keepLine || (unsplit && fetchPC == target))) {
+        processor->setBranch(false, 0);
+        return;
+    }
+    // If a branch has been taken, flush the IF/ID register
+    if (redirect) {
+        processor->stats.flushes += squashFetched<Policy>(true);
+        processor->setPC(target);
+        processor->setBranch(false, 0);
+    }
+}
+
+template <typename Policy>
+uint32_t InstructionFetch::squashFetched(bool fetchedNow) {
+    // ID shows the instruction in IF/ID blanked; the fetch stages behind it empty
+    IF_ID_Register& next = processor->getIF_ID();
+    uint32_t squashed = 0;
+    if (next.instruction || (fetchedNow && (!Policy::kGeneral || processor->getFetchLine().empty()))) {
+        next.isStall = true;
+        squashed++;
+    }
+    if (!Policy::kGeneral) {
+        return squashed;
+    }
+    for (IF_ID_Register& fetched : processor->getFetchLine()) {
+        if (fetched.instruction) squashed++;
+        fetched = IF_ID_Register();
+    }
+    return squashed;
+}
+
+template <typename Policy>
+void InstructionFetch::processWide(const int i) {
+    uint32_t width = processor->getIssueWidth();
+    if (processor->haltRequested) {
+        // Nothing is fetched after ecall/ebreak; the pipeline drains
+        for (uint32_t slot = 0; slot < width; slot++) {
+            processor->selectSlot(slot);
+            processor->getIF_ID() = IF_ID_Register();
+            vector<IF_ID_Register>& line = processor->getFetchLine();
+            fill(line.begin(), line.end(), IF_ID_Register());
+        }
+        return;
+    }
+    for (uint32_t slot = 0; slot < width; slot++) {
+        processor->selectSlot(slot);
+        const vector<IF_ID_Register>& line = processor->getFetchLine();
+        for (size_t stage = 0; stage < line.size(); stage++) {
+            if (line[stage].instruction) {
+                processor->markStage(line[stage].pc, line[stage].seq, i, PipelineTrace::IF | PipelineTrace::subStage(stage + 1));
+            }
+        }
+    }
+    bool redirect = processor->isBranchTaken();
+    uint32_t target = processor->getBranchTarget();
+    bool held = processor->bundleHeld();
+    if (redirect && held) {
+        // The branch or jump ended its group: the rest of its bundle, still
+        // waiting in IF/ID, is on the wrong path
+        for (uint32_t slot = 0; slot < width; slot++) {
+            processor->selectSlot(slot);
+            IF_ID_Register& waiting = processor->getIF_ID();
+            if (waiting.hazard.is_hazard) {
+                processor->stats.flushes++;
+                waiting.isStall = true;
+                waiting.hazard.is_hazard = false;
+            }
+        }
+        held = false;
+    }
+    if (processor->drainRequested) {
+        // Nothing more is fetched, but pc follows the instructions in flight
+        // so that it ends at the next instruction to execute
+        for (uint32_t slot = 0; slot < width; slot++) {
+            processor->selectSlot(slot);
+            if (!processor->memBusy && !held) {
+                processor->advanceFetch() = IF_ID_Register();
+            }
+            if (redirect) {
+                processor->stats.flushes += squashFetched<Policy>(false);
+            }
+        }
+        if (redirect) {
+            processor->setPC(target);
+            processor->setBranch(false, 0);
+        }
+        processor->fetchAccessStarted = false;
+        processor->fetchWaitCycles = 0;
+        return;
+    }
+    uint32_t fetchPC = processor->getPC();
+    if (Policy::kCheckPCAlignment && fetchPC % 4 != 0) {
+        processor->fetchFault = true;
+        return;
+    }
+    // The bundle: consecutive instructions up to a predicted taken branch or
+    // jump, the end of the program or, with an instruction cache, the end of
+    // the cache line, so that one access fetches all of them
+    uint32_t nextPC[PipelineStats::kMaxIssueWidth];
+    uint32_t count = 0;
+    uint32_t address = fetchPC;
+    uint32_t lineSize = processor->instructionCache ? processor->instructionCache->getConfig().lineSize : 0;
+    while (true) {
+        nextPC[count] = processor->branchPredictor ? processor->branchPredictor->predictNext(address) : address + 4;
+        // Past the program (e.g. at the return sentinel) pc stays put while
+        // the pipeline drains
+        if (processor->getDecoded(address).instruction == 0) {
+            nextPC[count] = address;
+        }
+        if (processor->instructionRow(address) < processor->getnoofinstructions()) {
+            processor->markStage(address, processor->fetchSeq + count, i, PipelineTrace::IF);
+        }
+        uint32_t next = nextPC[count++];
+        if (count == width || next != address + 4 || processor->getDecoded(next).instruction == 0 ||
+            (lineSize && next / lineSize != fetchPC / lineSize)) {
+            break;
+        }
+        address = next;
+    }
+    if (processor->memBusy || held) {
+        return;
+    }
+    // As in process(): a redirect keeps the bundle about to enter ID if it
+    // starts at the target, and otherwise squashes everything fetched so far
+    processor->selectSlot(0);
+    const vector<IF_ID_Register>& line = processor->getFetchLine();
+    bool keepLine = Policy::kKeepFetchAtTarget && redirect && !line.empty() &&
+        line.back().instruction && line.back().pc == target;
+    bool squashed = redirect && (line.empty() ? fetchPC != target : !keepLine);
+    if (processor->instructionCache && processor->instructionRow(fetchPC) < processor->getnoofinstructions() &&
+        !squashed) {
+        if (!processor->fetchAccessStarted) {
+            processor->fetchWaitCycles = processor->instructionCache->access(fetchPC, false);
+            processor->fetchAccessStarted = true;
+        }
+        if (processor->fetchWaitCycles > 0) {
+            processor->fetchWaitCycles--;
+            processor->stats.fetchStalls++;
+            for (uint32_t slot = 0; slot < width; slot++) {
+                processor->selectSlot(slot);
+                processor->advanceFetch() = IF_ID_Register();
+            }
+            if (keepLine) {
+                processor->setBranch(false, 0);
+            }
+            return;
+        }
+        processor->fetchAccessStarted = false;
+    }
+    for (uint32_t slot = 0; slot < width; slot++) {
+        processor->selectSlot(slot);
+        IF_ID_Register& fetched = processor->advanceFetch();
+        fetched = IF_ID_Register();
+        if (slot < count) {
+            const DecodedInstruction& decoded = processor->getDecoded(fetchPC + 4 * slot);
+            fetched.instruction = decoded.instruction;
+            fetched.decoded = &decoded;
+            fetched.pc = fetchPC + 4 * slot;
+            fetched.predictedNext = nextPC[slot];
+            fetched.seq = processor->fetchSeq++;
+        }
+    }
+    processor->setPC(nextPC[count - 1]);
+
+    if (Policy::kKeepFetchAtTarget && redirect && (keepLine || (line.empty() && fetchPC == target))) {
+        processor->setBranch(false, 0);
+        return;
+    }
+    if (redirect) {
+        for (uint32_t slot = 0; slot < width; slot++) {
+            processor->selectSlot(slot);
+            processor->stats.flushes += squashFetched<Policy>(slot == 0);
+        }
+        processor->setPC(target);
+        processor->setBranch(false, 0);
+    }
+}
+
+template <typename Policy>
+void InstructionDecode::process(const int i) {
+    // Get instruction from IF/ID register (fields were extracted at load time)
+    const DecodedInstruction& decoded = *processor->getIF_ID().decoded;
+    uint32_t instruction = decoded.instruction;
+    uint32_t pc = processor->getIF_ID().pc;
+    uint32_t opcode = decoded.opcode;
+    uint32_t rs1 = decoded.rs1;
+    uint32_t rs2 = decoded.rs2; // For I-type instructions, rs2 is not used
+    int32_t rd = decoded.rd;
+    if (processor->getIF_ID().instruction) {
+        processor->markStage(pc, processor->getIF_ID().seq, i, PipelineTrace::ID);
+    }
+    // MEM is waiting for the data cache: hold IF/ID
+    if (processor->memBusy) {
+        if (processor->getIF_ID().isStall && processor->instructionRow(pc) < processor->getnoofinstructions())
+            processor->markStage(pc, processor->getIF_ID().seq, i, PipelineTrace::CLEAR);
+        return;
+    }
+
+    // Check for hazards
+    if (Policy::decodeStalled(*processor)) {
+        processor->countStall(processor->hazardInID(), pc, processor->getIF_ID().seq);
+        // Insert a bubble (NOP) into ID/EX
+        processor->getID_EX().wb.regWrite = false;
+        processor->getID_EX().wb.memToReg = false;
+        processor->getID_EX().mem.branch = false;
+        processor->getID_EX().mem.memRead = false;
+        processor->getID_EX().mem.memWrite = false;
+        processor->getID_EX().mem.jump = false;
+        processor->getID_EX().ex.aluOp = 0;
+        processor->getID_EX().ex.aluSrc = false;
+        processor->getID_EX().rd = 0;
+        processor->getID_EX().rs1 = 0;
+        processor->getID_EX().rs2 = 0;
+        processor->getID_EX().immediate = 0;
+        processor->getID_EX().isStall = true;
+        // processor->setPC(processor->getPC() - 4);
+        return;
+    }
+
+    // If the IF/ID stage is stalled, just propagate the stall
+    if (processor->getIF_ID().isStall) {
+        if (processor->instructionRow(pc) < processor->getnoofinstructions())
+            processor->markStage(pc, processor->getIF_ID().seq, i, PipelineTrace::CLEAR);
+        processor->getID_EX().isStall = true;
+        return;
+    }
+    // Hold an instruction whose operands are not available yet
+    HazardType interlock = Policy::decodeInterlock(*processor, rs1, rs2);
+    if (interlock != HazardType::NONE) {
+        processor->countStall(interlock, pc, processor->getIF_ID().seq);
+        return;
+    }
+    // Immediate and control signals
+    int32_t immediate = decoded.immediate;
+    const ControlSignals& signals = decoded.signals;
+
+    // Read register values
+    int32_t readData1 = processor->getRegister(rs1);
+    int32_t readData2 = processor->getRegister(rs2);
+
+    Policy::forwardOperands(*processor, readData1, readData2);
+    // Function codes for R-type instructions
+    uint32_t funct3 = decoded.funct3;
+    uint32_t funct7 = decoded.funct7;
+
+    uint32_t branchTarget = static_cast<uint32_t>(static_cast<int32_t>(pc) + immediate);
+    if (opcode == 0b1100011) { // Branch instruction opcode
+        bool taken = branchTaken(funct3, readData1, readData2);
+        processor->resolveControlTransfer(pc, true, taken, branchTarget);
+    }
+    // ecall/ebreak end the program once the instructions ahead have completed
+    else if (opcode == 0b1110011) {
+        processor->haltRequested = true;
+    }
+    // Handle JAL instruction
+    else if (opcode == 0b1101111) { // JAL opcode
+        // Save return address (PC + 4) to rd
+        if (rd != 0) { // Don't write to x0
+            processor->setRegister(rd, pc + 4);
+        }
+        // Set branch target to PC + immediate
+        processor->resolveControlTransfer(pc, false, true, branchTarget);
+    }
+    // Handle JALR instruction
+    else if (opcode == 0b1100111 && funct3 == 0x0) { // JALR opcode
+        // Save return address (PC + 4) to rd
+        if (rd != 0) { // Don't write to x0
+            processor->setRegister(rd, pc + 4);
+        }
+        // Set branch target to rs1 + immediate (with lowest bit cleared)
+        processor->resolveControlTransfer(pc, false, true, (readData1 + immediate) & ~1);
+    }
+
+    // Update ID/EX register
+    processor->getID_EX().wb.regWrite = signals.regWrite;
+    processor->getID_EX().wb.memToReg = signals.memToReg;
+    processor->getID_EX().mem.branch = signals.branch;
+    processor->getID_EX().mem.memRead = signals.memRead;
+    processor->getID_EX().mem.memWrite = signals.memWrite;
+    processor->getID_EX().mem.jump = signals.jump;
+    processor->getID_EX().ex.aluOp = signals.aluOp;
+    processor->getID_EX().ex.aluSrc = signals.aluSrc;
+    processor->getID_EX().pc = pc;
+    processor->getID_EX().readData1 = readData1;
+    processor->getID_EX().readData2 = readData2;
+    processor->getID_EX().immediate = immediate;
+    processor->getID_EX().funct3 = funct3;
+    processor->getID_EX().funct7 = funct7;
+    processor->getID_EX().rd = rd;
+    processor->getID_EX().rs1 = rs1;
+    processor->getID_EX().rs2 = rs2;
+    processor->getID_EX().instruction = instruction;
+    processor->getID_EX().decoded = &decoded;
+    processor->getID_EX().seq = processor->getIF_ID().seq;
+    processor->getID_EX().isStall = false;
+    processor->getIF_ID().hazard.is_hazard = false;
+}
+
+template <typename Policy>
+void InstructionDecode::processWide(const int i) {
+    uint32_t width = processor->getIssueWidth();
+    // In order: once an instruction has to wait, so do the younger ones of
+    // its bundle in the slots after it
+    bool held = false;
+    uint32_t issued = 0;
+    for (uint32_t slot = 0; slot < width; slot++) {
+        processor->selectSlot(slot);
+        IF_ID_Register& if_id = processor->getIF_ID();
+        if (held) {
+            if (if_id.instruction && !if_id.isStall) {
+                processor->markStage(if_id.pc, if_id.seq, i, PipelineTrace::ID);
+                if_id.hazard.is_hazard = true;
+            }
+            processor->getID_EX().isStall = true;
+            continue;
+        }
+        process<Policy>(i);
+        if (processor->memBusy) {
+            continue;
+        }
+        if (processor->hazardInID() != HazardType::NONE || if_id.hazard.is_hazard) {
+            if_id.hazard.is_hazard = true;
+            held = true;
+        } else if (if_id.instruction && !if_id.isStall) {
+            issued++;
+        }
+    }
+    processor->stats.issueGroups[issued]++;
+    if (processor->memBusy) {
+        return;
+    }
+    // What has issued (or was squashed) leaves IF/ID, so that the bundle
+    // checks of the next cycle only see the instructions still waiting
+    for (uint32_t slot = 0; slot < width; slot++) {
+        processor->selectSlot(slot);
+        if (!processor->getIF_ID().hazard.is_hazard) {
+            processor->getIF_ID() = IF_ID_Register();
+        }
+    }
+}
+
+template <typename Policy>
+void Execute::process(const int i) {
+    // Get inputs from ID/EX register
+    uint32_t readData1 = processor->getID_EX().readData1;
+    uint32_t readData2 = processor->getID_EX().readData2;
+    int32_t immediate = processor->getID_EX().immediate;
+    uint32_t pc = processor->getID_EX().pc;
+    uint32_t funct3 = processor->getID_EX().funct3;
+    bool aluSrc = processor->getID_EX().ex.aluSrc;
+    const DecodedInstruction& decoded = *processor->getID_EX().decoded;
+    uint32_t instruction = decoded.instruction;
+    uint32_t opcode = decoded.opcode;
+    uint32_t rs1 = processor->getID_EX().rs1;
+    uint32_t rs2 = processor->getID_EX().rs2;
+
+    // Execute stages after the first (see PipelineDepth)
+    const vector<EX_MEM_Register>& line = processor->getExecuteLine();
+    for (size_t stage = 0; Policy::kGeneral && stage < line.size(); stage++) {
+        if (!line[stage].isStall && line[stage].instruction) {
+            processor->markStage(line[stage].pc, line[stage].seq, i, PipelineTrace::EX | PipelineTrace::subStage(stage + 1));
+        }
+    }
+
+    // MEM is waiting for the data cache: keep EX/MEM and hold this instruction
+    if (processor->memBusy) {
+        if (!processor->getID_EX().isStall && instruction) {
+            processor->markStage(pc, processor->getID_EX().seq, i, PipelineTrace::EX);
+        }
+        return;
+    }
+
+    // If stalled, propagate stall but still update visualization
+    if (processor->getID_EX().isStall) {
+        processor->advanceExecute<Policy::kGeneral>().isStall = true;
+        return;
+    }
+
+    // With split execute or memory stages (or several slots) the operands are
+    // forwarded here, from wherever the instructions ahead have got to by now
+    if (Policy::kForwarding && Policy::kGeneral && processor->generalHazards()) {
+        readData1 = processor->bypassValue(rs1, processor->getID_EX().seq);
+        readData2 = processor->bypassValue(rs2, processor->getID_EX().seq);
+    }
+
+    // Use immediate value if aluSrc is true, otherwise use the forwarded or original rs2 value
+    uint32_t input2 = aluSrc ? immediate : readData2;
+
+    int32_t aluResult = 0;
+    bool zero = false;
+
+    if (opcode == 0b0010111) { // AUIPC
+        // For AUIPC: rd = PC + (immediate) where immediate is already shifted left 12.
+        aluResult = pc + immediate;
+    } else if (opcode == 0b0110111) { // LUI
+        aluResult = immediate;
+    } else {
+        // ALU control was selected from aluOp/funct3/funct7 when the program was decoded
+        int32_t aluControl = decoded.aluControl;
+        aluResult = performALU(aluControl, readData1, input2, zero);
+    }
+    // A multi-cycle mul/div/rem hands its result to the unit, which writes
+    // rd itself once the latency has passed; the instruction goes on to MEM
+    // and WB without a result, so that nothing forwards or writes it early
+    bool multiCycle = processor->mulDivUnit && processor->mulDivUnit->isMultiCycle(decoded.aluControl);
+    if (multiCycle) {
+        // Never sooner than an add; without forwarding, once ID can read it
+        // from the register file after the memory stages and WB
+        const PipelineDepth& depth = processor->getPipelineDepth();
+        int latency = max(processor->mulDivUnit->latency(decoded.aluControl), depth.execute);
+        int delay = Policy::kForwarding ? 0 : depth.execute + depth.memory;
+        processor->mulDivUnit->issue(decoded.aluControl, i, processor->getID_EX().wb.regWrite ? processor->getID_EX().rd : 0,
+                                     aluResult, i + latency - 1 + delay);
+    }
+
+    // Update EX/MEM register (or the second execute stage)
+    EX_MEM_Register& result = processor->advanceExecute<Policy::kGeneral>();
+    result.wb = processor->getID_EX().wb;
+    if (multiCycle) {
+        result.wb.regWrite = false;
+    }
+    result.mem = processor->getID_EX().mem;
+    result.zero = zero;
+    result.aluResult = aluResult;
+    result.readData2 = readData2; // Use forwarded value for memory writes
+    result.funct3 = funct3;
+    result.rd = processor->getID_EX().rd;
+    result.instruction = instruction;
+    result.decoded = &decoded;
+    result.seq = processor->getID_EX().seq;
+    result.isStall = false;
+    result.pc = pc;
+    result.rs1 = rs1;
+    result.rs2 = rs2;
+    if (processor->getID_EX().instruction) {
+        processor->markStage(pc, processor->getID_EX().seq, i, PipelineTrace::EX);
+    }
+}
+
+// Implementation of MemoryAccess::process
+template <typename Policy>
+void MemoryAccess::process(const int i) {
+    bool memRead = processor->getEX_MEM().mem.memRead;
+    bool memWrite = processor->getEX_MEM().mem.memWrite;
+    int32_t aluResult = processor->getEX_MEM().aluResult;
+    uint32_t writeData = processor->getEX_MEM().readData2;
+    uint32_t funct3 = processor->getEX_MEM().funct3;
+    uint32_t instruction = processor->getEX_MEM().instruction;
+    uint32_t pc = processor->getEX_MEM().pc;
+
+    // Memory stages after the first (see PipelineDepth)
+    const vector<MEM_WB_Register>& line = processor->getMemoryLine();
+    for (size_t stage = 0; Policy::kGeneral && stage < line.size(); stage++) {
+        if (!line[stage].isStall && line[stage].instruction) {
+            processor->markStage(line[stage].pc, line[stage].seq, i, PipelineTrace::MEM | PipelineTrace::subStage(stage + 1));
+        }
+    }
+
+    // If stalled, propagate stall
+    if (processor->getEX_MEM().isStall) {
+        processor->advanceMemory<Policy::kGeneral>().isStall = true;
+        return;
+    }
+    // The access of another slot waits for the data cache: hold this
+    // instruction with it (see Processor::cycle)
+    if (processor->memBusy) {
+        processor->advanceMemory<Policy::kGeneral>().isStall = true;
+        if (instruction) {
+            processor->markStage(pc, processor->getEX_MEM().seq, i, PipelineTrace::MEM);
+        }
+        return;
+    }
+
+    // A data cache miss keeps the access in MEM until the line has been
+    // filled, sending bubbles to WB while the stages behind it hold
+    if (processor->dataCache && (memRead || memWrite)) {
+        if (!processor->memAccessStarted) {
+            processor->memWaitCycles = processor->dataCache->access(aluResult, memWrite);
+            processor->memAccessStarted = true;
+        }
+        if (processor->memWaitCycles > 0) {
+            processor->memWaitCycles--;
+            processor->memBusy = true;
+            processor->stats.memoryStalls++;
+            processor->advanceMemory<Policy::kGeneral>().isStall = true;
+            processor->markStage(pc, processor->getEX_MEM().seq, i, PipelineTrace::MEM);
+            return;
+        }
+        processor->memAccessStarted = false;
+    }
+
+    // Memory access operations
+    int32_t readData = 0;
+    if (memRead) {
+        readData = processor->loadData(aluResult, funct3);
+    }
+
+    if (memWrite) {
+        // With split stages the store data is forwarded as late as here
+        if (Policy::kForwarding && Policy::kGeneral && processor->generalHazards()) {
+            writeData = processor->bypassValue(processor->getEX_MEM().rs2, processor->getEX_MEM().seq);
+        }
+        processor->storeData(aluResult, funct3, writeData);
+    }
+
+    // Update MEM/WB register (or the second memory stage)
+    MEM_WB_Register& result = processor->advanceMemory<Policy::kGeneral>();
+    result.wb = processor->getEX_MEM().wb;
+    result.readData = readData;
+    result.aluResult = aluResult;
+    result.rd = processor->getEX_MEM().rd;
+    result.instruction = instruction;
+    result.decoded = processor->getEX_MEM().decoded;
+    result.seq = processor->getEX_MEM().seq;
+    result.isStall = false;
+    result.pc = pc;
+
+    if (processor->getEX_MEM().instruction) {
+        processor->markStage(pc, processor->getEX_MEM().seq, i, PipelineTrace::MEM);
+    }
+}
+
+// Implementation of WriteBack::process
+template <typename Policy>
+void WriteBack::process(const int i) {
+    // Get inputs from MEM/WB register
+    bool regWrite = processor->getMEM_WB().wb.regWrite;
+    bool memToReg = processor->getMEM_WB().wb.memToReg;
+    int32_t readData = processor->getMEM_WB().readData;
+    int32_t aluResult = processor->getMEM_WB().aluResult;
+    uint32_t rd = processor->getMEM_WB().rd;
+    uint32_t pc = processor->getMEM_WB().pc;
+
+    // If stalled, do nothing
+    if (processor->getMEM_WB().isStall) {
+        return;
+    }
+    // Write back to register file
+    uint32_t opcode = processor->getMEM_WB().decoded->opcode;
+    bool is_jump = (opcode == 0b1101111 || opcode == 0b1100111); // JAL or JALR
+    
+    // Jumps already wrote rd in ID; only write it again if the policy says so
+    if (regWrite && rd != 0 && (Policy::kWriteBackJumps || !is_jump)) { // Don't write to x0
+        int32_t writeData = memToReg ? readData : aluResult;
+        processor->setRegister(rd, writeData);
+    }
+
+    if (processor->getMEM_WB().instruction) {
+        processor->stats.retired++;
+        processor->markStage(pc, processor->getMEM_WB().seq, i, PipelineTrace::WB);
+    }
+}
+
+void Processor::updateForwardingSignals() {
+    ForwardingSignals& forwarding = getForwarding();
+    forwarding.forwardA = 0;
+    forwarding.forwardB = 0;
+
+    // Reset forwarding flags in IF/ID
+    getIF_ID().rs1forwarded = false;
+    getIF_ID().rs2forwarded = false;
+
+    // Normal forwarding for ID/EX stage
+    uint32_t rs1_ex = getID_EX().rs1;
+    uint32_t rs2_ex = getID_EX().rs2;
+
+    // Get information from IF/ID register for branch/JALR forwarding
+    const DecodedInstruction& if_id_decoded = *getIF_ID().decoded;
+    uint32_t if_id_opcode = if_id_decoded.opcode;
+    uint32_t if_id_rs1 = if_id_decoded.rs1;
+    uint32_t if_id_rs2 = if_id_decoded.rs2; // Only used for branches and stores
+    bool is_branch = (if_id_opcode == 0b1100011); // BEQ, BNE, etc.
+    bool is_jalr = (if_id_opcode == 0b1100111);   // JALR
+    bool is_store = (if_id_opcode == 0b0100011);  // Store instruction
+
+    // EX hazard - Forward from EX/MEM to ID/EX
+    if (getEX_MEM().wb.regWrite && !getEX_MEM().isStall &&
+        (getEX_MEM().rd != 0) &&
+        (getEX_MEM().rd == rs1_ex)) {
+        forwarding.forwardA = 2;
+        getID_EX().readData1 = getEX_MEM().aluResult; // Update input1 directly
+    }
+
+    if (getEX_MEM().wb.regWrite && !getEX_MEM().isStall &&
+        (getEX_MEM().rd != 0) &&
+        (getEX_MEM().rd == rs2_ex)) {
+        forwarding.forwardB = 2;
+        getID_EX().readData2 = getEX_MEM().aluResult; // Update input2 directly
+    }
+
+    // MEM hazard - Forward from MEM/WB to ID/EX
+    if (getMEM_WB().wb.regWrite && !getMEM_WB().isStall &&
+        (getMEM_WB().rd != 0) &&
+        !(getEX_MEM().wb.regWrite && !getEX_MEM().isStall && (getEX_MEM().rd != 0) && (getEX_MEM().rd == rs1_ex)) &&
+        (getMEM_WB().rd == rs1_ex)) {
+        forwarding.forwardA = 1;
+        getID_EX().readData1 = getMEM_WB().wb.memToReg ?
+            getMEM_WB().readData :
+            getMEM_WB().aluResult; // Update input1 directly
+    }
+
+    if (getMEM_WB().wb.regWrite && !getMEM_WB().isStall &&
+        (getMEM_WB().rd != 0) &&
+        !(getEX_MEM().wb.regWrite && !getEX_MEM().isStall && (getEX_MEM().rd != 0) && (getEX_MEM().rd == rs2_ex)) &&
+        (getMEM_WB().rd == rs2_ex)) {
+        forwarding.forwardB = 1;
+        getID_EX().readData2 = getMEM_WB().wb.memToReg ?
+            getMEM_WB().readData :
+            getMEM_WB().aluResult; // Update input2 directly
+    }
+
+    // Special case: Forward from MEM/WB to EX/MEM for load-store sequence
+    // This handles the case where a load is immediately followed by a store that uses the loaded value as store data
+    // Example: lw x2, 0(x3) followed by sw x2, 0(x3)
+    if (getEX_MEM().mem.memWrite && // Current instruction in EX/MEM is a store
+        getMEM_WB().wb.memToReg &&   // Previous instruction in MEM/WB is a load
+        getMEM_WB().wb.regWrite &&   // Previous instruction writes to a register
+        getMEM_WB().rd != 0 &&       // Previous instruction writes to a non-zero register
+        getMEM_WB().rd == getEX_MEM().rs2) { // Store is using the register being loaded as store data
+
+        // Forward the loaded value directly to the store data in EX/MEM
+        getEX_MEM().readData2 = getMEM_WB().readData;
+    }
+
+    // Forward to IF/ID for branch/JALR instructions
+    if (is_branch || is_jalr) {
+        // Forward from MEM/WB to IF/ID
+        if (getMEM_WB().wb.regWrite && !getMEM_WB().isStall && getMEM_WB().rd != 0) {
+            int32_t forwarded_value = getMEM_WB().wb.memToReg ?
+                getMEM_WB().readData :
+                getMEM_WB().aluResult;
+
+            // Update for rs1 if needed
+            if (if_id_rs1 != 0 && if_id_rs1 == getMEM_WB().rd) {
+                // We need to store this value where the ID stage can use it for branch evaluation
+                getIF_ID().rs1data = forwarded_value;
+                getIF_ID().rs1forwarded = true;
+            }
+
+            // Update for rs2 if needed (for branch instructions)
+            if (is_branch && if_id_rs2 != 0 && if_id_rs2 == getMEM_WB().rd) {
+                getIF_ID().rs2data = forwarded_value;
+                getIF_ID().rs2forwarded = true;
+            }
+        }
+
+        // Forward from EX/MEM to IF/ID (higher priority)
+        if (getEX_MEM().wb.regWrite && !getEX_MEM().isStall && getEX_MEM().rd != 0) {
+            // Only forward for non-load instructions (load results aren't available yet)
+            if (!(getEX_MEM().mem.memRead)) {
+                int32_t forwarded_value = getEX_MEM().aluResult;
+
+                // Update for rs1 if needed
+                if (if_id_rs1 != 0 && if_id_rs1 == getEX_MEM().rd) {
+                    getIF_ID().rs1data = forwarded_value;
+                    getIF_ID().rs1forwarded = true;
+                }
+
+                // Update for rs2 if needed (for branch instructions)
+                if (is_branch && if_id_rs2 != 0 && if_id_rs2 == getEX_MEM().rd) {
+                    getIF_ID().rs2data = forwarded_value;
+                    getIF_ID().rs2forwarded = true;
+                }
+            }
+        }
+    }
+
+    // Forward to IF/ID for store instructions
+    if (is_store) {
+        // Forward from MEM/WB to IF/ID store
+        if (getMEM_WB().wb.regWrite && !getMEM_WB().isStall && getMEM_WB().rd != 0) {
+            int32_t forwarded_value = getMEM_WB().wb.memToReg ?
+                getMEM_WB().readData :
+                getMEM_WB().aluResult;
+
+            // Update for rs2 (store data) if needed
+            if (if_id_rs2 != 0 && if_id_rs2 == getMEM_WB().rd) {
+                getIF_ID().rs2data = forwarded_value;
+                getIF_ID().rs2forwarded = true;
+            }
+
+            // Also handle base address register if it's being forwarded
+            if (if_id_rs1 != 0 && if_id_rs1 == getMEM_WB().rd) {
+                getIF_ID().rs1data = forwarded_value;
+                getIF_ID().rs1forwarded = true;
+            }
+        }
+
+        // Forward from EX/MEM to IF/ID store (higher priority)
+        if (getEX_MEM().wb.regWrite && !getEX_MEM().isStall && getEX_MEM().rd != 0) {
+            // Only forward for non-load instructions
+            if (!(getEX_MEM().mem.memRead)) {
+                int32_t forwarded_value = getEX_MEM().aluResult;
+
+                // Update for rs2 (store data) if needed
+                if (if_id_rs2 != 0 && if_id_rs2 == getEX_MEM().rd) {
+                    getIF_ID().rs2data = forwarded_value;
+                    getIF_ID().rs2forwarded = true;
+                }
+
+                // Also handle base address register if it's being forwarded
+                if (if_id_rs1 != 0 && if_id_rs1 == getEX_MEM().rd) {
+                    getIF_ID().rs1data = forwarded_value;
+                    getIF_ID().rs1forwarded = true;
+                }
+            }
+        }
+    }
+
+    // Handle the case: lw x2, 0(x3) then sw x4, 0(x2)
+    // The checkForHazards() function correctly stalls for this case
+    // but we need to forward from MEM/WB to ID/EX after the stall cycle
+
+    // Check if the current instruction in ID/EX is a store and uses a register loaded in the previous cycle
+    uint32_t id_ex_opcode = getID_EX().decoded->opcode;
+    bool id_ex_is_store = (id_ex_opcode == 0b0100011);
+
+    if (id_ex_is_store &&
+        getMEM_WB().wb.memToReg && // Previous instruction was a load
+        getMEM_WB().wb.regWrite &&
+        getMEM_WB().rd != 0 &&
+        getMEM_WB().rd == getID_EX().rs1) { // Store uses the loaded value as address base
+
+        // Forward the loaded value to the store address base register
+        getID_EX().readData1 = getMEM_WB().readData;
+    }
+}
+
+HazardType Processor::checkForHazards() {
+    // Get information from IF/ID register
+    const DecodedInstruction& decoded = *getIF_ID().decoded;
+    uint32_t rs1 = decoded.rs1;
+    uint32_t rs2 = decoded.rs2; // For I-type instructions, rs2 is not relevant
+    uint32_t opcode = decoded.opcode;
+
+    // Results of the multiplier/divider are never forwarded
+    HazardType mulDiv = checkMulDivHazard(true);
+    if (mulDiv != HazardType::NONE) {
+        return mulDiv;
+    }
+    if (generalHazards()) {
+        return checkDeepHazards();
+    }
+    
+    //lw addi
+    // Check for load-use hazard
+    if (opcode != 0b0100011 && getID_EX().mem.memRead && getID_EX().rd != 0 && !getID_EX().isStall &&
+        ((getID_EX().rd == rs1 && rs1 != 0) || 
+         (getID_EX().rd == rs2 && rs2 != 0))) {
+        // Signal a hazard - but exclude store instructions (store data doesn't need stall)
+        return HazardType::LOAD_USE;
+    }
+    
+    // Special check for load followed by store that uses the loaded value as address base
+    if (opcode == 0b0100011 && // Store instruction
+        getID_EX().mem.memRead && // Previous instruction is a load
+        getID_EX().rd != 0 && 
+        getID_EX().rd == rs1) {  // Store is using the loaded register as address base
+        return HazardType::LOAD_STORE_BASE;
+    }
+    
+    //addi jalr/addi beq
+    // Check for ALU instruction feeding into branch/JALR
+    if ((opcode == 0b1100011 || opcode == 0b1100111) && // Branch or JALR
+        getID_EX().wb.regWrite && getID_EX().rd != 0 && 
+        // !getID_EX().mem.jump && getID_EX().mem.branch &&
+        ((getID_EX().rd == rs1) || (opcode == 0b1100011 && getID_EX().rd == rs2))) {
+        // Signal a hazard when an instruction in ID/EX is writing to a register
+        // that this branch/JALR in IF/ID needs to read
+        return opcode == 0b1100011 ? HazardType::ALU_BRANCH : HazardType::ALU_JALR;
+    }
+    
+    //lw then beq
+    // Check for branch hazard - need to check if it's a branch instruction
+    if (opcode == 0b1100011) { // Branch instruction opcode (beq, bne, blt, bge, etc.)
+        // Only check for hazard if the instruction in EX/MEM is a load instruction
+        uint32_t ex_mem_opcode = getEX_MEM().decoded->opcode;
+        bool is_load = (ex_mem_opcode == 0b0000011); // Load instruction opcode
+        
+        // Check if any of the registers used in the branch are being written by a load instruction in EX/MEM
+        if (!getEX_MEM().isStall && is_load &&
+            (getEX_MEM().wb.regWrite && getEX_MEM().rd != 0) && 
+            (getEX_MEM().rd == rs1 || getEX_MEM().rd == rs2)) {
+            return HazardType::LOAD_BRANCH; // Branch hazard detected with load instruction
+        }
+    }
+    //lw then jalr
+    // Check for JALR hazard - JALR uses rs1 for target address calculation
+    if (opcode == 0b1100111) { // JALR instruction opcode
+        // Only check for hazard if the instruction in EX/MEM is a load instruction
+        uint32_t ex_mem_opcode = getEX_MEM().decoded->opcode;
+        bool is_load = (ex_mem_opcode == 0b0000011); // Load instruction opcode
+        
+        // Check if the source register used in JALR is being written by a load instruction in EX/MEM
+        if (!getEX_MEM().isStall && is_load &&
+            (getEX_MEM().wb.regWrite && getEX_MEM().rd != 0) && 
+            (getEX_MEM().rd == rs1)) {
+            return HazardType::LOAD_JALR; // JALR hazard detected with load instruction
+        }
+    }
+    
+    // JAL doesn't use source registers, so no data hazard possible for JAL
+    return HazardType::NONE;
+}
+
+namespace {
+bool isJump(const DecodedInstruction& decoded) {
+    return decoded.opcode == 0b1101111 || decoded.opcode == 0b1100111; // JAL or JALR
+}
+} // namespace
+
+template <typename Visit>
+void Processor::forEachWriter(Visit visit) const {
+    auto writes = [](const auto& latch) { return latch.wb.regWrite && latch.rd != 0 && !latch.isStall; };
+    // Jumps write pc + 4, loads the data read in the first memory stage
+    auto executed = [](const EX_MEM_Register& latch) {
+        return isJump(*latch.decoded) ? static_cast<int32_t>(latch.pc + 4) : latch.aluResult;
+    };
+    auto accessed = [](const MEM_WB_Register& latch) {
+        if (latch.wb.memToReg) return static_cast<int32_t>(latch.readData);
+        return isJump(*latch.decoded) ? static_cast<int32_t>(latch.pc + 4) : latch.aluResult;
+    };
+    // Nothing has been computed in ID/EX yet, but a jump wrote rd in ID
+    auto issued = [](const ID_EX_Register& latch) {
+        return isJump(*latch.decoded) ? static_cast<int32_t>(latch.pc + 4) : 0;
+    };
+    const PipelineSlot* end = slots + issueWidth;
+    uint32_t distance = 0;
+    for (const PipelineSlot* lane = slots; lane != end; lane++) {
+        const ID_EX_Register& id_ex = lane->id_ex;
+        if (writes(id_ex)) visit(distance, id_ex.seq, id_ex.rd, *id_ex.decoded, issued(id_ex));
+    }
+    for (size_t stage = 0; stage < slots[0].executeLine.size(); stage++) {
+        distance++;
+        for (const PipelineSlot* lane = slots; lane != end; lane++) {
+            const EX_MEM_Register& latch = lane->executeLine[stage];
+            if (writes(latch)) visit(distance, latch.seq, latch.rd, *latch.decoded, executed(latch));
+        }
+    }
+    distance++;
+    for (const PipelineSlot* lane = slots; lane != end; lane++) {
+        const EX_MEM_Register& ex_mem = lane->ex_mem;
+        if (writes(ex_mem)) visit(distance, ex_mem.seq, ex_mem.rd, *ex_mem.decoded, executed(ex_mem));
+    }
+    for (size_t stage = 0; stage < slots[0].memoryLine.size(); stage++) {
+        distance++;
+        for (const PipelineSlot* lane = slots; lane != end; lane++) {
+            const MEM_WB_Register& latch = lane->memoryLine[stage];
+            if (writes(latch)) visit(distance, latch.seq, latch.rd, *latch.decoded, accessed(latch));
+        }
+    }
+    distance++;
+    for (const PipelineSlot* lane = slots; lane != end; lane++) {
+        const MEM_WB_Register& mem_wb = lane->mem_wb;
+        if (writes(mem_wb)) visit(distance, mem_wb.seq, mem_wb.rd, *mem_wb.decoded, accessed(mem_wb));
+    }
+}
+
+int32_t Processor::bypassValue(uint32_t reg, uint64_t seq) const {
+    if (reg == 0) return 0;
+    // A latch the next stage has already read this cycle holds the same
+    // instruction as that stage's output, which is visited later and wins
+    bool found = false;
+    uint64_t youngest = 0;
+    int32_t value = 0;
+    forEachWriter([&](uint32_t, uint64_t writer, uint32_t rd, const DecodedInstruction&, int32_t result) {
+        if (rd == reg && writer < seq && (!found || writer >= youngest)) {
+            found = true;
+            youngest = writer;
+            value = result;
+        }
+    });
+    return found ? value : getRegister(reg);
+}
+
+HazardType Processor::checkDeepHazards() {
+    const DecodedInstruction& decoded = *getIF_ID().decoded;
+    if (getIF_ID().isStall || getIF_ID().instruction == 0) {
+        return HazardType::NONE;
+    }
+    if (issueWidth > 1) {
+        HazardType bundle = checkBundleHazards();
+        if (bundle != HazardType::NONE) return bundle;
+    }
+    bool branch = decoded.opcode == 0b1100011;
+    bool jalr = decoded.opcode == 0b1100111;
+    bool store = decoded.opcode == 0b0100011;
+    uint64_t seq = getIF_ID().seq;
+    auto check = [&](uint32_t reg, bool usedInID) {
+        if (reg == 0) return HazardType::NONE;
+        // Youngest older instruction writing reg and how far it has got
+        const DecodedInstruction* writer = nullptr;
+        uint64_t youngest = 0;
+        uint32_t at = 0;
+        forEachWriter([&](uint32_t distance, uint64_t other, uint32_t rd, const DecodedInstruction& instruction, int32_t) {
+            if (rd == reg && other < seq && (!writer || other >= youngest)) {
+                writer = &instruction;
+                youngest = other;
+                at = distance;
+            }
+        });
+        // Jumps wrote rd in ID
+        if (!writer || isJump(*writer)) return HazardType::NONE;
+        bool load = writer->signals.memToReg;
+        // The result is there at the end of the last execute (or memory)
+        // stage; this instruction is in the first execute stage next cycle,
+        // but a branch or JALR uses its operands in ID already
+        uint32_t produced = depth.execute - 1 + (load ? depth.memory : 0);
+        if (at + (usedInID ? 0 : 1) > produced) return HazardType::NONE;
+        if (branch) return load ? HazardType::LOAD_BRANCH : HazardType::ALU_BRANCH;
+        if (jalr) return load ? HazardType::LOAD_JALR : HazardType::ALU_JALR;
+        if (store) return load ? HazardType::LOAD_STORE_BASE : HazardType::ALU_USE;
+        return load ? HazardType::LOAD_USE : HazardType::ALU_USE;
+    };
+    HazardType hazard = check(decoded.rs1, branch || jalr);
+    // Store data is forwarded as late as the first memory stage, where it
+    // is always available
+    if (hazard == HazardType::NONE && !store) {
+        hazard = check(decoded.rs2, branch);
+    }
+    return hazard;
+}
+
+HazardType Processor::checkDeepInterlock(uint32_t rs1, uint32_t rs2) {
+    // ID runs after the later stages: the latches hold what they produced
+    // this cycle, and whatever is still in one of them has not written back
+    if (issueWidth > 1) {
+        HazardType bundle = checkBundleHazards();
+        if (bundle != HazardType::NONE) return bundle;
+    }
+    HazardType hazard = HazardType::NONE;
+    forEachWriter([&](uint32_t distance, uint64_t, uint32_t rd, const DecodedInstruction&, int32_t) {
+        if (distance == 0 || (rd != rs1 && rd != rs2)) return;
+        HazardType found = distance <= depth.execute ? HazardType::RAW_EX
+            : distance < depth.execute + depth.memory ? HazardType::RAW_MEM : HazardType::RAW_WB;
+        // Report the instruction furthest from writing back
+        if (hazard == HazardType::NONE) hazard = found;
+    });
+    return hazard;
+}
+
+HazardType Processor::checkBundleHazards() const {
+    const IF_ID_Register& own = slot->if_id;
+    if (own.isStall || own.instruction == 0) {
+        return HazardType::NONE;
+    }
+    const DecodedInstruction& decoded = *own.decoded;
+    // U- and J-type instructions have no source registers
+    bool sources = decoded.type != InstructionType::U_TYPE && decoded.type != InstructionType::J_TYPE;
+    uint32_t rs1 = sources ? decoded.rs1 : 0;
+    uint32_t rs2 = sources ? decoded.rs2 : 0;
+    bool memory = decoded.signals.memRead || decoded.signals.memWrite;
+    for (const PipelineSlot* older = slots; older != slot; older++) {
+        if (older->if_id.isStall || older->if_id.instruction == 0) continue;
+        const DecodedInstruction& other = *older->if_id.decoded;
+        // Branches and jumps redirect fetch from ID, ecall/ebreak stops it,
+        // and the multiplier/divider starts one operation a cycle
+        if (other.opcode == 0b1100011 || isJump(other) || other.opcode == 0b1110011 ||
+            (mulDivUnit && mulDivUnit->isMultiCycle(other.aluControl))) {
+            return HazardType::PAIRING;
+        }
+        if (other.signals.regWrite && other.rd != 0 && (other.rd == rs1 || other.rd == rs2)) {
+            return HazardType::BUNDLE_RAW;
+        }
+        // A single data cache port
+        if (memory && (other.signals.memRead || other.signals.memWrite)) {
+            return HazardType::PAIRING;
+        }
+    }
+    return HazardType::NONE;
+}
+
+bool Processor::bundleHeld() const {
+    for (uint32_t index = 0; index < issueWidth; index++) {
+        if (slots[index].if_id.hazard.is_hazard) return true;
+    }
+    return false;
+}
+
+HazardType Processor::checkMulDivHazard(bool issuingInEX) {
+    if (!mulDivUnit || getIF_ID().isStall || getIF_ID().instruction == 0) {
+        return HazardType::NONE;
+    }
+    const DecodedInstruction& decoded = *getIF_ID().decoded;
+    int cycle = currentCycle - 1; // The cycle being simulated
+    // Registers the instruction reads or writes, 0 where it has none
+    uint32_t rs1 = decoded.rs1;
+    uint32_t rs2 = decoded.rs2;
+    uint32_t rd = decoded.signals.regWrite ? decoded.rd : 0;
+    auto uses = [&](uint32_t reg) { return reg != 0 && (reg == rs1 || reg == rs2 || reg == rd); };
+
+    // A multi-cycle operation in ID/EX (of any slot) that EX is about to start
+    const DecodedInstruction* ahead = nullptr;
+    for (uint32_t index = 0; issuingInEX && index < issueWidth; index++) {
+        const ID_EX_Register& id_ex = slots[index].id_ex;
+        if (!id_ex.isStall && id_ex.instruction != 0 && mulDivUnit->isMultiCycle(id_ex.decoded->aluControl)) {
+            ahead = id_ex.decoded;
+            if (id_ex.wb.regWrite && uses(id_ex.rd)) {
+                return HazardType::MULDIV_RESULT;
+            }
+        }
+    }
+    if (mulDivUnit->pending(rs1, cycle) || mulDivUnit->pending(rs2, cycle) || mulDivUnit->pending(rd, cycle)) {
+        return HazardType::MULDIV_RESULT;
+    }
+    // With split memory stages an older instruction writing the same rd may
+    // still be on its way to WB when the unit writes the result: wait for it
+    if (issuingInEX && depth.deepBackend() && rd != 0 && mulDivUnit->isMultiCycle(decoded.aluControl)) {
+        uint32_t ready = max(mulDivUnit->latency(decoded.aluControl), depth.execute);
+        bool overtakes = false;
+        forEachWriter([&](uint32_t distance, uint64_t, uint32_t writes, const DecodedInstruction& writer, int32_t) {
+            if (writes == rd && !isJump(writer) && depth.execute + depth.memory - distance > ready) overtakes = true;
+        });
+        if (overtakes) {
+            return HazardType::MULDIV_RESULT;
+        }
+    }
+    // An iterative unit takes the next operation once the last one is done
+    if (mulDivUnit->isMultiCycle(decoded.aluControl)) {
+        bool busy = !mulDivUnit->canIssue(decoded.aluControl, cycle + 1);
+        if (ahead && mulDivUnit->sharesIterativeUnit(ahead->aluControl, decoded.aluControl)) {
+            busy = busy || mulDivUnit->latency(ahead->aluControl) > 1;
+        }
+        if (busy) {
+            return HazardType::MULDIV_BUSY;
+        }
+    }
+    return HazardType::NONE;
+}
+
+void Processor::completeMulDiv(int cycle) {
+    mulDivUnit->complete(cycle, [&](uint32_t rd, int32_t value) {
+        setRegister(rd, value);
+        // The register file now holds a newer value than an older
+        // instruction forwarded to IF/ID at the start of the cycle
+        if (getIF_ID().decoded->rs1 == rd) getIF_ID().rs1forwarded = false;
+        if (getIF_ID().decoded->rs2 == rd) getIF_ID().rs2forwarded = false;
+    });
+}
+
+// Update the cycle method
+template <typename Policy, bool kTimeStages>
+void Processor::cycle(const int i) {
+    stats.cycles++;
+    if (outOfOrderCore) {
+        outOfOrderCore->cycle(i);
+        return;
+    }
+    if (Policy::kGeneral && issueWidth > 1) {
+        wideCycle<Policy, kTimeStages>(i);
+        return;
+    }
+    if (!kTimeStages) {
+        Policy::beginCycle(*this);
+        // Execute in reverse order to prevent data hazards
+        wbStage.process<Policy>(i);  // WB stage
+        if (mulDivUnit) completeMulDiv(i);
+        memBusy = false;
+        memStage.process<Policy>(i); // MEM stage
+        exStage.process<Policy>(i);  // EX stage
+        idStage.process<Policy>(i);  // ID stage
+        ifStage.process<Policy>(i);  // IF stage
+        return;
+    }
+    // Same sequence with a timestamp after every part
+    typedef chrono::steady_clock Clock;
+    double* seconds = stageTimes->seconds;
+    Clock::time_point start = Clock::now();
+    auto lap = [&](StageTimes::Part part) {
+        Clock::time_point now = Clock::now();
+        seconds[part] += chrono::duration<double>(now - start).count();
+        start = now;
+    };
+    Policy::beginCycle(*this);
+    lap(StageTimes::HAZARDS);
+    wbStage.process<Policy>(i);
+    if (mulDivUnit) completeMulDiv(i);
+    lap(StageTimes::WB);
+    memBusy = false;
+    memStage.process<Policy>(i);
+    lap(StageTimes::MEM);
+    exStage.process<Policy>(i);
+    lap(StageTimes::EX);
+    idStage.process<Policy>(i);
+    lap(StageTimes::ID);
+    ifStage.process<Policy>(i);
+    lap(StageTimes::IF);
+}
+
+template <typename Policy, bool kTimeStages>
+void Processor::wideCycle(const int i) {
+    typedef chrono::steady_clock Clock;
+    Clock::time_point start;
+    if (kTimeStages) start = Clock::now();
+    auto lap = [&](StageTimes::Part part) {
+        if (!kTimeStages) return;
+        Clock::time_point now = Clock::now();
+        stageTimes->seconds[part] += chrono::duration<double>(now - start).count();
+        start = now;
+    };
+    Policy::beginCycle(*this);
+    lap(StageTimes::HAZARDS);
+    // Every slot goes through the later stages, oldest first
+    uint64_t retired = stats.retired;
+    for (uint32_t index = 0; index < issueWidth; index++) {
+        selectSlot(index);
+        wbStage.process<Policy>(i);
+    }
+    if (stats.retired > retired + 1) {
+        stats.coRetired += stats.retired - retired - 1;
+    }
+    if (mulDivUnit) completeMulDiv(i);
+    lap(StageTimes::WB);
+    memBusy = false;
+    uint32_t missed = issueWidth;
+    for (uint32_t index = 0; index < issueWidth; index++) {
+        selectSlot(index);
+        memStage.process<Policy>(i);
+        if (memBusy && missed == issueWidth) missed = index;
+    }
+    // A data cache miss holds its group in MEM, but the older instructions
+    // in the slots before it have gone on already: EX/MEM no longer holds them
+    for (uint32_t index = 0; memBusy && index < missed; index++) {
+        slots[index].ex_mem.isStall = true;
+    }
+    lap(StageTimes::MEM);
+    for (uint32_t index = 0; index < issueWidth; index++) {
+        selectSlot(index);
+        exStage.process<Policy>(i);
+    }
+    lap(StageTimes::EX);
+    idStage.processWide<Policy>(i);
+    lap(StageTimes::ID);
+    ifStage.processWide<Policy>(i);
+    selectSlot(0);
+    lap(StageTimes::IF);
+}
+
+template <typename Policy, bool kTimeStages>
+int Processor::runPipeline(int cycles, bool untilHalt, uint64_t retireLimit) {
+    // Run for specified number of cycles, numbered on from currentCycle
+    if (untilHalt && isHalted()) {
+        return 0; // Another cycle would fetch past the end of the program
+    }
+    int ran = cycles;
+    // Spill at multiples of the window, so that runs split into many short
+    // slices (HartGroup) spill as often as one long run
+    int nextSpill = -1;
+    if (pipelineStream) {
+        int window = pipelineStream->getWindow();
+        nextSpill = (currentCycle / window + 1) * window;
+    }
+    for (int n = 0; n < cycles; n++) {
+        int i = currentCycle++;
+        cycle<Policy, kTimeStages>(i);
+        if (fetchFault) {
+            return n + 1;
+        }
+        if (instructionTrace) {
+            instructionTrace->retireBefore(oldestInFlight());
+        }
+        if (currentCycle == nextSpill) {
+            // Stages only ever mark the current cycle, so every earlier one is final
+            pipelineStream->flush(pipelineTrace, instructionLines.size(), nextSpill);
+            nextSpill += pipelineStream->getWindow();
+        }
+        if ((untilHalt && isHalted()) || stats.retired >= retireLimit) {
+            ran = n + 1;
+            break;
+        }
+    }
+    return ran;
+}
+
+int Processor::simulate(int cycles, bool untilHalt, uint64_t retireLimit) {
+    int ran = step(cycles, untilHalt, retireLimit);
+    if (untilHalt && ran == cycles && !isHalted() && stats.retired < retireLimit) {
+        cerr << "Warning: program did not finish within " << cycles << " cycles" << endl;
+    }
+    return ran;
+}
+
+template <bool kGeneral>
+int Processor::stepShape(int cycles, bool untilHalt, uint64_t retireLimit) {
+    if (stageTimes) {
+        return forwardingEnabled ? runPipeline<ForwardingPolicy<kGeneral>, true>(cycles, untilHalt, retireLimit)
+                                 : runPipeline<NoForwardingPolicy<kGeneral>, true>(cycles, untilHalt, retireLimit);
+    }
+    if (forwardingEnabled) {
+        return runPipeline<ForwardingPolicy<kGeneral>, false>(cycles, untilHalt, retireLimit);
+    }
+    return runPipeline<NoForwardingPolicy<kGeneral>, false>(cycles, untilHalt, retireLimit);
+}
+
+int Processor::step(int cycles, bool untilHalt, uint64_t retireLimit) {
+    // Pick the pipeline instantiation once; nothing inside the cycle loop
+    // depends on the forwarding mode at run time, and the five-stage scalar
+    // pipeline does not pay for split stages or issue slots
+    if (depth == PipelineDepth() && issueWidth == 1) {
+        return stepShape<false>(cycles, untilHalt, retireLimit);
+    }
+    return stepShape<true>(cycles, untilHalt, retireLimit);
+}
+
+int Processor::run(int cycles, const string& inputFile, bool untilHalt) {
+    int ran = simulate(cycles, untilHalt);
+    if (fetchFault) {
+        return ran; // Misaligned pc: the run is abandoned without a diagram
+    }
+    print_pipeline(currentCycle, forwardingEnabled, inputFile);
+    return ran;
+}
@@ -0,0 +1,132 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include "Processor.hpp"
+
+// Forwarding/hazard policies of the pipeline. The stage templates in
+// Pipeline.cpp are instantiated once per policy, so every difference between
+// the two processors is resolved at compile time. Each policy comes in two
+// shapes (kGeneral): the default five-stage scalar pipeline, and one that
+// also handles split stages and several issue slots (see PipelineDepth and
+// Processor::setIssueWidth); Processor::step() picks both at run time.
+//
+// A policy provides:
+//   kForwarding          names the output file and selects the policy at run time
+//   kGeneral             split stages or several slots may be configured; when
+//                        false, the stages skip those paths altogether
+//   kCheckPCAlignment    stop the simulation when pc is not word aligned
+//   kKeepFetchAtTarget   a redirect to the instruction just fetched keeps it
+//                        instead of flushing and refetching it
+//   kWriteBackJumps      JAL/JALR also write rd in WB (it is written in ID)
+//   beginCycle           work done before the stages run
+//   fetchStalled         IF must hold the IF/ID register this cycle
+//   decodeStalled        ID inserts a bubble before looking at IF/ID
+//   decodeInterlock      ID stalls the instruction reading rs1/rs2; returns
+//                        the cause, or HazardType::NONE
+//   forwardOperands      replace register file values with forwarded ones
+
+// Processor with forwarding paths: hazards are detected and values are
+// forwarded at the start of the cycle, before any latch is overwritten.
+template <bool kGeneralShape>
+struct ForwardingPolicy {
+    static constexpr bool kForwarding = true;
+    static constexpr bool kGeneral = kGeneralShape;
+    static constexpr bool kCheckPCAlignment = true;
+    static constexpr bool kKeepFetchAtTarget = true;
+    static constexpr bool kWriteBackJumps = false;
+
+    static void beginCycle(Processor& processor) {
+        if (kGeneral && processor.getIssueWidth() > 1) {
+            for (uint32_t slot = 0; slot < processor.getIssueWidth(); slot++) {
+                processor.selectSlot(slot);
+                processor.hazardInID() = processor.checkForHazards();
+            }
+            processor.selectSlot(0);
+            return;
+        }
+        processor.hazardInID() = processor.checkForHazards();
+        if (!kGeneral || !processor.getPipelineDepth().deepBackend()) {
+            processor.updateForwardingSignals();
+        }
+    }
+    static bool fetchStalled(Processor& processor) {
+        return processor.hazardInID() != HazardType::NONE;
+    }
+    static bool decodeStalled(Processor& processor) {
+        return processor.hazardInID() != HazardType::NONE;
+    }
+    static HazardType decodeInterlock(Processor&, uint32_t, uint32_t) {
+        return HazardType::NONE;
+    }
+    static void forwardOperands(Processor& processor, int32_t& readData1, int32_t& readData2) {
+        if (kGeneral && processor.generalHazards()) {
+            // Wherever the instructions ahead have got to (see checkDeepHazards)
+            const IF_ID_Register& if_id = processor.getIF_ID();
+            readData1 = processor.bypassValue(if_id.decoded->rs1, if_id.seq);
+            readData2 = processor.bypassValue(if_id.decoded->rs2, if_id.seq);
+            return;
+        }
+        if (processor.getIF_ID().rs1forwarded) {
+            readData1 = processor.getIF_ID().rs1data;
+        }
+        if (processor.getIF_ID().rs2forwarded) {
+            readData2 = processor.getIF_ID().rs2data;
+        }
+    }
+};
+
+// Processor without forwarding: ID holds an instruction until every older
+// instruction writing one of its source registers has written back.
+template <bool kGeneralShape>
+struct NoForwardingPolicy {
+    static constexpr bool kForwarding = false;
+    static constexpr bool kGeneral = kGeneralShape;
+    static constexpr bool kCheckPCAlignment = false;
+    static constexpr bool kKeepFetchAtTarget = false;
+    static constexpr bool kWriteBackJumps = true;
+
+    static void beginCycle(Processor&) {}
+    static bool fetchStalled(Processor& processor) {
+        return processor.getIF_ID().hazard.is_hazard;
+    }
+    static bool decodeStalled(const Processor&) {
+        return false;
+    }
+    static HazardType decodeInterlock(Processor& processor, uint32_t rs1, uint32_t rs2) {
+        HazardType mulDiv = processor.checkMulDivHazard(false);
+        if (mulDiv != HazardType::NONE) {
+            processor.getIF_ID().hazard.is_hazard = true;
+            processor.getID_EX().isStall = true;
+            return mulDiv;
+        }
+        if (kGeneral && processor.generalHazards()) {
+            HazardType hazard = processor.checkDeepInterlock(rs1, rs2);
+            if (hazard != HazardType::NONE) {
+                processor.getIF_ID().hazard.is_hazard = true;
+                processor.getID_EX().isStall = true;
+            }
+            return hazard;
+        }
+        if (processor.getID_EX().wb.regWrite && (processor.getID_EX().rd != 0) && (processor.getID_EX().isStall == false) &&
+            (((rs1 != 0) && (processor.getID_EX().rd == rs1)) || ((rs2 != 0) && (processor.getID_EX().rd == rs2)))) {
+            processor.getIF_ID().hazard.is_hazard = true;
+            processor.getID_EX().isStall = true;
+            return HazardType::RAW_EX;
+        }
+        if (processor.getEX_MEM().wb.regWrite && (processor.getEX_MEM().rd != 0) && (processor.getEX_MEM().isStall == false) &&
+            (((rs1 != 0) && (processor.getEX_MEM().rd == rs1)) || ((rs2 != 0) && (processor.getEX_MEM().rd == rs2)))) {
+            processor.getIF_ID().hazard.is_hazard = true;
+            return HazardType::RAW_MEM;
+        }
+        if (processor.getMEM_WB().wb.regWrite && (processor.getMEM_WB().rd != 0) && (processor.getMEM_WB().isStall == false) &&
+            (((rs1 != 0) && (processor.getMEM_WB().rd == rs1)) || ((rs2 != 0) && (processor.getMEM_WB().rd == rs2)))) {
+            processor.getIF_ID().hazard.is_hazard = true;
+            processor.getID_EX().isStall = true;
+            return HazardType::RAW_WB;
+        }
+        return HazardType::NONE;
+    }
+    static void forwardOperands(Processor&, int32_t&, int32_t&) {}
+};
+
+#endif // PIPELINE_HPP
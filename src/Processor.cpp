@@ -3,30 +3,42 @@
 #include <sstream>  //error fixed //Provides stringstream, istringstream, and ostringstream for string manipulation.
 #include <vector>
 #include <map>
+#include <algorithm>
 #include <cstdint>  //Defines fixed-width integer types like int8_t, uint16_t, int32_t, uint64_t.
 #include <iomanip>  //Provides manipulators like std::setw, std::setprecision, std::fixed, std::hex, etc.
 #include "Processor.hpp"
 
 // Processor constructor implementation
-Processor::Processor(const string& filename, const int cyclecount) {
-    registers[0] = 0; // x0 is hardwired to 0
-    loadInstructions(filename, cyclecount);
-
-    // Initialize pipeline stages
-    ifStage = new InstructionFetch(this);
-    idStage = new InstructionDecode(this);
-    exStage = new Execute(this);
-    memStage = new MemoryAccess(this);
-    wbStage = new WriteBack(this);
+namespace {
+shared_ptr<const DecodedProgram> loadOrExit(const string& filename) {
+    string error;
+    shared_ptr<const DecodedProgram> program = DecodedProgram::load(filename, error);
+    if (!program) {
+        cerr << "Error: " << error << endl;
+        exit(1);
+    }
+    return program;
 }
+} // namespace
 
-// Processor destructor implementation
-Processor::~Processor() {
-    delete ifStage;
-    delete idStage;
-    delete exStage;
-    delete memStage;
-    delete wbStage;
+Processor::Processor(const string& filename, const int cyclecount) : Processor(loadOrExit(filename), cyclecount) {}
+
+Processor::Processor(shared_ptr<const DecodedProgram> program, const int cyclecount)
+    : program(move(program)), instructionLines(this->program->lines), instructionMemory(this->program->instructions),
+      textBase(this->program->textBase) {
+    registers[0] = 0; // x0 is hardwired to 0
+    if (this->program->executable) {
+        // Initialized data (and a readable copy of the code) in data memory;
+        // .bss is left to the zero-filled pages
+        for (const ProgramImage::Segment& segment : this->program->segments) {
+            memory.load(segment.address, segment.bytes.data(), segment.bytes.size());
+        }
+        entryPoint = this->program->entry;
+        initialSP = kStackTop;
+        initialGP = this->program->globalPointer;
+    }
+    pipelineTrace.reserve(cyclecount);
+    reset(false); // pc, sp and gp at the program's initial values
 }
 
 // Now implement the Processor methods
@@ -35,6 +47,29 @@ void Processor::setBranch(bool taken, uint32_t target) {
     branchTarget = target;
 }
 
+void Processor::resolveControlTransfer(uint32_t pc, bool conditional, bool taken, uint32_t target) {
+    if (conditional) {
+        stats.branches++;
+        if (taken) stats.takenBranches++;
+    } else {
+        stats.jumps++;
+    }
+    if (!branchPredictor) {
+        if (taken) {
+            stats.mispredictions++;
+            setBranch(true, target);
+        }
+        return;
+    }
+    branchPredictor->update(pc, conditional, taken, target);
+    // IF already fetched from predictedNext; redirect if that was wrong
+    uint32_t actualNext = taken ? target : pc + 4;
+    if (slot->if_id.predictedNext != actualNext) {
+        stats.mispredictions++;
+        setBranch(true, actualNext);
+    }
+}
+
 int32_t Processor::getRegister(int index) const {
     if (index == 0) return 0; // x0 is hardwired to 0
     return registers[index];
@@ -46,24 +81,351 @@ void Processor::setRegister(int index, int32_t value) {
     }
 }
 
-uint32_t Processor::getMemory(uint32_t address) const {
-    auto it = memory.find(address);
-    if (it != memory.end()) {
-        return it->second;
+const DecodedInstruction kNoInstruction;
+
+bool Processor::isHalted() const {
+    if (outOfOrderCore) return outOfOrderCore->finished();
+    bool fetchStopped = haltRequested || ((drainRequested || getDecoded(pc).instruction == 0) && !isBranch);
+    return fetchStopped && isPipelineEmpty();
+}
+
+bool Processor::isPipelineEmpty() const {
+    if (outOfOrderCore) return outOfOrderCore->empty();
+    auto empty = [](const auto& latch) { return latch.isStall || latch.instruction == 0; };
+    for (const PipelineSlot* lane = slots; lane != slots + issueWidth; lane++) {
+        if (!empty(lane->if_id) || !empty(lane->id_ex) || !empty(lane->ex_mem) || !empty(lane->mem_wb) ||
+            !all_of(lane->fetchLine.begin(), lane->fetchLine.end(), empty) ||
+            !all_of(lane->executeLine.begin(), lane->executeLine.end(), empty) ||
+            !all_of(lane->memoryLine.begin(), lane->memoryLine.end(), empty)) {
+            return false;
+        }
+    }
+    return !mulDivUnit || mulDivUnit->idle();
+}
+
+void Processor::reset(bool untilHalt) {
+    pipelineTrace.clear();
+    if (pipelineStream) {
+        pipelineStream->clear();
+    }
+    currentCycle = 0;
+    startCycle = 0;
+
+    // Reset pipeline registers
+    for (PipelineSlot& lane : slots) {
+        lane = PipelineSlot();
+        lane.fetchLine.assign(depth.fetch - 1, IF_ID_Register());
+        lane.executeLine.assign(depth.execute - 1, EX_MEM_Register());
+        lane.memoryLine.assign(depth.memory - 1, MEM_WB_Register());
+    }
+    slot = slots;
+
+    // Reset processor state
+    pc = entryPoint;
+    isBranch = false;
+    branchTarget = 0;
+    haltRequested = false;
+    drainRequested = false;
+    fetchFault = false;
+    stats.clear(instructionMemory.size());
+    if (dataCache) {
+        dataCache->clear();
+    }
+    memBusy = false;
+    memAccessStarted = false;
+    memWaitCycles = 0;
+    if (instructionCache) {
+        instructionCache->clear();
+    }
+    fetchAccessStarted = false;
+    fetchWaitCycles = 0;
+    if (branchPredictor) {
+        branchPredictor->clear();
+    }
+    if (mulDivUnit) {
+        mulDivUnit->clear();
+    }
+    if (outOfOrderCore) {
+        outOfOrderCore->reset();
+    }
+
+    for (int i = 1; i < 32; i++) {
+        registers[i] = 0;
+    }
+    registers[2] = initialSP ? initialSP - hartId * kHartStackSize : 0;
+    registers[3] = initialGP;
+    registers[4] = hartId;
+    if (untilHalt) {
+        // A final "ret" leaves the program
+        registers[1] = kReturnSentinel;
+    }
+}
+
+uint64_t Processor::oldestInFlight() const {
+    if (outOfOrderCore) return outOfOrderCore->oldestInFlight();
+    uint64_t oldest = fetchSeq;
+    auto visit = [&](const auto& latch) {
+        if (latch.instruction) oldest = min(oldest, latch.seq);
+    };
+    for (const PipelineSlot* lane = slots; lane != slots + issueWidth; lane++) {
+        visit(lane->if_id);
+        visit(lane->id_ex);
+        visit(lane->ex_mem);
+        visit(lane->mem_wb);
+        for_each(lane->fetchLine.begin(), lane->fetchLine.end(), visit);
+        for_each(lane->executeLine.begin(), lane->executeLine.end(), visit);
+        for_each(lane->memoryLine.begin(), lane->memoryLine.end(), visit);
     }
-    return 0; // Return 0 for uninitialized memory
+    return oldest;
 }
 
-void Processor::setMemory(uint32_t address, uint32_t value) {
-    memory[address] = value;
+bool Processor::startInstructionTrace(const string& filename) {
+    TraceHeader header;
+    header.forwarding = forwardingEnabled;
+    header.textBase = textBase;
+    header.firstCycle = currentCycle;
+    header.labels = instructionLines;
+    instructionTrace.reset(new InstructionTraceWriter());
+    if (!instructionTrace->open(filename, header)) {
+        cerr << "Error: Could not create trace " << filename << endl;
+        instructionTrace.reset();
+        return false;
+    }
+    return true;
 }
 
-uint32_t Processor::getInstruction(uint32_t address) const {
-    auto it = instructionMemory.find(address);
-    if (it != instructionMemory.end()) {
-        return it->second;
+bool Processor::finishInstructionTrace() {
+    if (!instructionTrace) return true;
+    bool written = instructionTrace->finish(currentCycle);
+    instructionTrace.reset();
+    if (!written) {
+        cerr << "Error writing the instruction trace" << endl;
     }
-    return 0; // Return 0 for non-existent instruction
+    return written;
+}
+
+bool Processor::stepFunctional() {
+    const DecodedInstruction& decoded = getDecoded(pc);
+    if (haltRequested || decoded.instruction == 0) {
+        return false; // Program has finished or pc left it
+    }
+    if (functionalWarming && instructionCache) {
+        instructionCache->access(pc, false);
+    }
+    int32_t readData1 = getRegister(decoded.rs1);
+    int32_t readData2 = getRegister(decoded.rs2);
+    uint32_t nextPC = pc + 4;
+    uint32_t target = pc + static_cast<uint32_t>(decoded.immediate);
+    // Load/store/jalr address, wrapping like EX rather than overflowing int32_t
+    uint32_t address = static_cast<uint32_t>(readData1) + static_cast<uint32_t>(decoded.immediate);
+    bool zero = false;
+
+    switch (decoded.opcode) {
+    case 0b0110011: // R-type
+    case 0b0010011: // I-type ALU
+        setRegister(decoded.rd, Execute::performALU(decoded.aluControl, readData1,
+            decoded.signals.aluSrc ? decoded.immediate : readData2, zero));
+        break;
+    case 0b0000011: // Load
+        if (functionalWarming && dataCache) {
+            dataCache->access(address, false);
+        }
+        setRegister(decoded.rd, loadData(address, decoded.funct3));
+        break;
+    case 0b0100011: // Store
+        if (functionalWarming && dataCache) {
+            dataCache->access(address, true);
+        }
+        storeData(address, decoded.funct3, readData2);
+        break;
+    case 0b0110111: // LUI
+        setRegister(decoded.rd, decoded.immediate);
+        break;
+    case 0b0010111: // AUIPC
+        setRegister(decoded.rd, target);
+        break;
+    case 0b1100011: { // Branch
+        bool taken = InstructionDecode::branchTaken(decoded.funct3, readData1, readData2);
+        if (taken) nextPC = target;
+        if (functionalWarming && branchPredictor) {
+            branchPredictor->update(pc, true, taken, target);
+        }
+        break;
+    }
+    case 0b1101111: // JAL
+        setRegister(decoded.rd, pc + 4);
+        nextPC = target;
+        if (functionalWarming && branchPredictor) {
+            branchPredictor->update(pc, false, true, nextPC);
+        }
+        break;
+    case 0b1100111: // JALR (target uses rs1 as read before rd is written)
+        setRegister(decoded.rd, pc + 4);
+        nextPC = address & ~1u;
+        if (functionalWarming && branchPredictor) {
+            branchPredictor->update(pc, false, true, nextPC);
+        }
+        break;
+    case 0b1110011: // ecall/ebreak
+        haltRequested = true;
+        break;
+    default:
+        // Unknown or unsupported instruction
+        break;
+    }
+    pc = nextPC;
+    return true;
+}
+
+uint64_t Processor::runFunctional(uint64_t maxInstructions) {
+    uint64_t executed = 0;
+    while (executed < maxInstructions && stepFunctional()) {
+        executed++;
+    }
+    return executed;
+}
+
+void Processor::printRegisters(ostream& out) const {
+    out << "pc = " << pc << endl;
+    for (int i = 0; i < 32; i++) {
+        out << "x" << i << " = " << getRegister(i);
+        // Print in columns of 4 registers per line
+        if (i % 4 == 3 || i == 31) {
+            out << endl;
+        } else {
+            out << "\t";
+        }
+    }
+}
+
+bool PipelineDepth::parse(const string& text, PipelineDepth& depth) {
+    uint32_t* parts[] = { &depth.fetch, &depth.execute, &depth.memory };
+    istringstream in(text);
+    string field;
+    size_t count = 0;
+    while (getline(in, field, ':')) {
+        if (count == 3 || field.empty() || field.find_first_not_of("0123456789") != string::npos) return false;
+        uint32_t stages = static_cast<uint32_t>(strtoul(field.c_str(), nullptr, 10));
+        if (stages == 0 || stages > kMaxStages) return false;
+        *parts[count++] = stages;
+    }
+    return count == 3;
+}
+
+string PipelineDepth::describe() const {
+    return to_string(fetch) + ":" + to_string(execute) + ":" + to_string(memory);
+}
+
+bool parseRunOptions(int argc, char* argv[], RunOptions& options) {
+    int maxCycles = Processor::kDefaultMaxCycles;
+    bool valid = argc >= 3;
+    for (int i = 3; valid && i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--max-cycles" && i + 1 < argc) {
+            maxCycles = atoi(argv[++i]);
+            valid = maxCycles > 0;
+        } else if (arg == "--forward") {
+            options.forwarding = true;
+        } else if (arg == "--no-forward") {
+            options.forwarding = false;
+        } else if (arg == "--functional") {
+            options.functional = true;
+        } else if (arg == "--fast-forward" && i + 1 < argc) {
+            options.fastForward = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--stats") {
+            options.stats = true;
+        } else if (arg == "--restore" && i + 1 < argc) {
+            options.restoreCheckpoint = argv[++i];
+        } else if (arg == "--checkpoint" && i + 1 < argc) {
+            options.saveCheckpoint = argv[++i];
+        } else if (arg == "--dcache" && i + 1 < argc) {
+            options.dataCacheEnabled = true;
+            valid = CacheConfig::parse(argv[++i], options.dataCache);
+        } else if (arg == "--predictor" && i + 1 < argc) {
+            valid = PredictorConfig::parse(argv[++i], options.predictor);
+        } else if (arg == "--icache" && i + 1 < argc) {
+            options.instructionCacheEnabled = true;
+            valid = CacheConfig::parse(argv[++i], options.instructionCache);
+        } else if (arg == "--muldiv" && i + 1 < argc) {
+            options.mulDivEnabled = true;
+            valid = MulDivConfig::parse(argv[++i], options.mulDiv);
+        } else if (arg == "--depth" && i + 1 < argc) {
+            valid = PipelineDepth::parse(argv[++i], options.depth);
+        } else if (arg == "--width" && i + 1 < argc) {
+            int width = atoi(argv[++i]);
+            valid = width > 0 && width <= static_cast<int>(PipelineStats::kMaxIssueWidth);
+            options.width = width;
+        } else if (arg == "--ooo" && i + 1 < argc) {
+            options.outOfOrderEnabled = true;
+            valid = OutOfOrderConfig::parse(argv[++i], options.outOfOrder);
+        } else if (arg == "--trace" && i + 1 < argc) {
+            options.traceFile = argv[++i];
+        } else if (arg == "--sample" && i + 1 < argc) {
+            options.sampled = true;
+            valid = SamplingConfig::parse(argv[++i], options.sampling);
+        } else if (arg == "--harts" && i + 1 < argc) {
+            int harts = atoi(argv[++i]);
+            valid = harts > 0;
+            options.harts = harts;
+        } else if (arg == "--parallel" && i + 1 < argc) {
+            options.quantum = atoi(argv[++i]);
+            valid = options.quantum > 0;
+        } else {
+            valid = false;
+        }
+    }
+    if (valid) {
+        options.inputFile = argv[1];
+        options.untilHalt = string(argv[2]) == "halt";
+        options.cycles = options.untilHalt ? maxCycles : atoi(argv[2]);
+        valid = options.cycles > 0;
+    }
+    if (!valid) {
+        cerr << "Usage: " << argv[0] << " <input_file> <cycle_count|halt> [options]" << endl;
+        cerr << "  halt              run until the program finishes (ecall/ebreak, returning to" << endl;
+        cerr << "                    the initial ra, or running off the end)" << endl;
+        cerr << "  --max-cycles N    cap for halt mode (default " << Processor::kDefaultMaxCycles << ")" << endl;
+        cerr << "  --forward         simulate the processor with forwarding paths" << endl;
+        cerr << "  --no-forward      simulate the processor without forwarding" << endl;
+        cerr << "  --functional      execute without the pipeline model and print the registers;" << endl;
+        cerr << "                    the cycle count limits the number of instructions" << endl;
+        cerr << "  --fast-forward N  execute N instructions functionally, then simulate the" << endl;
+        cerr << "                    pipeline from that point" << endl;
+        cerr << "  --stats           print cycle, stall and flush counters as JSON" << endl;
+        cerr << "  --checkpoint FILE save the state the run ends in (after the cycle count," << endl;
+        cerr << "                    or with --functional after that many instructions)" << endl;
+        cerr << "  --restore FILE    continue from a checkpoint of the same program; the cycle" << endl;
+        cerr << "                    count is the number of further cycles" << endl;
+        cerr << "  --dcache SPEC     add an L1 data cache, SPEC = size:ways:line[:lru|plru][:wb|wt][:miss cycles]" << endl;
+        cerr << "                    e.g. 4096:2:32:lru:wb:10" << endl;
+        cerr << "  --icache SPEC     add an L1 instruction cache (same SPEC; the write policy is unused)" << endl;
+        cerr << "  --predictor SPEC  predict the next fetch address: not-taken, btb[:entries]," << endl;
+        cerr << "                    bimodal[:bits[:entries]] or gshare[:bits[:history[:entries]]]" << endl;
+        cerr << "  --muldiv SPEC     multi-cycle mul/div/rem, SPEC = mul:div[:rem][:pipelined|iterative]" << endl;
+        cerr << "                    latencies in cycles, e.g. 3:20 (default: pipelined multiplier," << endl;
+        cerr << "                    iterative divider)" << endl;
+        cerr << "  --depth SPEC      split fetch, execute and memory access into several stages," << endl;
+        cerr << "                    SPEC = fetch:execute:memory, each 1 to " << PipelineDepth::kMaxStages
+             << ", e.g. 2:2:2 (default 1:1:1)" << endl;
+        cerr << "  --width N         issue up to N (1 to " << PipelineStats::kMaxIssueWidth
+             << ") instructions a cycle in order, one per" << endl;
+        cerr << "                    slot; the diagram shows every instruction on its own row" << endl;
+        cerr << "  --ooo SPEC        simulate an out-of-order core instead of the pipeline," << endl;
+        cerr << "                    SPEC = rob:iq:lsq:width[:physical registers], e.g. 32:16:16:2" << endl;
+        cerr << "  --trace FILE      also write a binary record of every dynamic instruction" << endl;
+        cerr << "                    (render it with tracerender)" << endl;
+        cerr << "  --sample SPEC     sampled simulation, SPEC = period:window[:warming[:detailed]]" << endl;
+        cerr << "                    in instructions, e.g. 100000:1000:10000:50; prints the CPI" << endl;
+        cerr << "                    and stall estimates as JSON, the cycle count limits the" << endl;
+        cerr << "                    number of instructions" << endl;
+        cerr << "  --harts N         run the program on N cores sharing the data memory, each" << endl;
+        cerr << "                    with its hart id in tp; they advance in lock-step, one" << endl;
+        cerr << "                    cycle each in turn, and write one diagram per hart" << endl;
+        cerr << "  --parallel Q      run every hart on its own host thread instead, meeting" << endl;
+        cerr << "                    every Q cycles (not deterministic when harts share data" << endl;
+        cerr << "                    within Q cycles)" << endl;
+    }
+    return valid;
 }
 
 // Implementation of InstructionDecode helper methods
@@ -189,21 +551,60 @@ ControlSignals InstructionDecode::generateControlSignals(uint32_t instruction) {
     return signals;
 }
 
+DecodedInstruction InstructionDecode::decode(uint32_t instruction) {
+    DecodedInstruction decoded;
+    decoded.instruction = instruction;
+    decoded.opcode = instruction & 0x7F;
+    decoded.type = getInstructionType(instruction);
+    decoded.signals = generateControlSignals(instruction);
+    decoded.immediate = extractImmediate(instruction, decoded.type);
+    decoded.rs1 = (instruction >> 15) & 0x1F;
+    decoded.rs2 = (instruction >> 20) & 0x1F;
+    // For I-type instructions (addi, load, jalr) rs2 is not used
+    if (decoded.opcode == 0b0010011 || decoded.opcode == 0b0000011 || decoded.opcode == 0b1100111) {
+        decoded.rs2 = 0;
+    }
+    decoded.rd = (instruction >> 7) & 0x1F;
+    decoded.funct3 = (instruction >> 12) & 0x7;
+    decoded.funct7 = (instruction >> 25) & 0x7F;
+    // The upper bits of an I-type ALU immediate are no funct7, except that
+    // they tell srai from srli
+    uint32_t funct7 = decoded.funct7;
+    if (decoded.opcode == 0b0010011) {
+        funct7 = decoded.funct3 == 0x5 ? funct7 & 0x20 : 0;
+    }
+    decoded.aluControl = Execute::getALUControl(decoded.signals.aluOp, decoded.funct3, funct7);
+    return decoded;
+}
+
+bool InstructionDecode::branchTaken(uint32_t funct3, int32_t a, int32_t b) {
+    switch (funct3) {
+    case 0x0: return a == b; // BEQ
+    case 0x1: return a != b; // BNE
+    case 0x4: return a < b;  // BLT
+    case 0x5: return a >= b; // BGE
+    case 0x6: return (uint32_t)a < (uint32_t)b;  // BLTU
+    case 0x7: return (uint32_t)a >= (uint32_t)b; // BGEU
+    default: return false;
+    }
+}
+
 // Update getALUControl in the Execute class:
 uint32_t Execute::getALUControl(uint32_t aluOp, uint32_t funct3, uint32_t funct7) {
     if (aluOp == 0) {
         return 2; // add for load/store
     } else if (aluOp == 1) {
         return 6; // subtract for branch
+    } else if (aluOp != 2) {
+        return 2; // LUI and AUIPC, which EX computes itself
     } else {
         // Check for M-extension instructions first.
         if (funct7 == 0x01) {
-            if (funct3 == 0x0)
-                return 11; // mul
-            else if (funct3 == 0x4)
-                return 12; // div
-            else if (funct3 == 0x6)
-                return 13; // rem
+            static const uint32_t kMulDiv[8] = {
+                11, 16, 17, 18, // mul, mulh, mulhsu, mulhu
+                12, 19, 13, 20  // div, divu, rem, remu
+            };
+            return kMulDiv[funct3];
         }
         // R-type / I-type ALU instructions
         if (funct3 == 0) {
@@ -218,7 +619,7 @@ uint32_t Execute::getALUControl(uint32_t aluOp, uint32_t funct3, uint32_t funct7
         } else if (funct3 == 1) {
             return 7; // SLL
         } else if (funct3 == 5) {
-            return 8; // SRL/SRA
+            return funct7 == 32 ? 14 : 8; // SRA : SRL
         } else if (funct3 == 2) {
             return 9; // SLT
         } else if (funct3 == 3) {
@@ -246,19 +647,34 @@ uint32_t Execute::performALU(uint32_t aluControl, uint32_t input1, uint32_t inpu
         result = input1 - input2; break;
     case 7: // SLL
         result = input1 << (input2 & 0x1F); break;
-    case 8: // SRL/SRA
-        // Using logical shift; for arithmetic shifts, additional checks are needed.
+    case 8: // SRL
         result = input1 >> (input2 & 0x1F); break;
+    case 14: // SRA
+        result = static_cast<int32_t>(input1) >> (input2 & 0x1F); break;
     case 9: // SLT
         result = ((int32_t)input1 < (int32_t)input2) ? 1 : 0; break;
     case 10: // SLTU
         result = (input1 < input2) ? 1 : 0; break;
     case 11: // MUL (M-extension)
-        result = (int32_t)input1 * (int32_t)input2; break;
-    case 12: // DIV (M-extension)
-        result = (input2 == 0) ? -1 : (int32_t)input1 / (int32_t)input2; break;
-    case 13: // REM (M-extension)
-        result = (input2 == 0) ? input1 : (int32_t)input1 % (int32_t)input2; break;
+        result = input1 * input2; break;
+    case 16: // MULH
+        result = ((int64_t)(int32_t)input1 * (int32_t)input2) >> 32; break;
+    case 17: // MULHSU
+        result = ((int64_t)(int32_t)input1 * (int64_t)input2) >> 32; break;
+    case 18: // MULHU
+        result = ((uint64_t)input1 * input2) >> 32; break;
+    case 12: // DIV (M-extension); the overflowing INT32_MIN / -1 gives INT32_MIN
+        result = (input2 == 0) ? -1 :
+            (input1 == 0x80000000u && input2 == 0xFFFFFFFFu) ? input1 : (int32_t)input1 / (int32_t)input2;
+        break;
+    case 19: // DIVU
+        result = (input2 == 0) ? UINT32_MAX : input1 / input2; break;
+    case 13: // REM (M-extension); INT32_MIN % -1 is 0
+        result = (input2 == 0) ? input1 :
+            (input1 == 0x80000000u && input2 == 0xFFFFFFFFu) ? 0 : (int32_t)input1 % (int32_t)input2;
+        break;
+    case 20: // REMU
+        result = (input2 == 0) ? input1 : input1 % input2; break;
     default:
         result = 0;
     }
@@ -266,7 +682,313 @@ uint32_t Execute::performALU(uint32_t aluControl, uint32_t input1, uint32_t inpu
     return result;
 }
 
-void Processor::print_pipeline(int cycles, bool forwardingEnabled, const string& inputFile) {
+// Text cells of the pipeline diagram
+namespace {
+const char* const kBlankCell = "        ;";
+const char* const kStallCell = "   -    ;";
+
+// Replays the stage writes recorded in `stages` in the order the stages run
+// within a cycle (WB, MEM, EX, ID, IF), each stage combining with the cell left
+// by the stages before it.
+const char* renderCell(uint8_t stages) {
+    // A later stage of a split fetch, execute or memory stage is numbered;
+    // where it shares the cell with another stage the number is left out
+    uint32_t subStage = stages >> PipelineTrace::kSubStageShift;
+    stages &= ~PipelineTrace::kSubStageMask;
+    if (subStage > 0) {
+        static const char* const kSubStageTexts[][3] = {
+            { "   IF2  ;", "   IF3  ;", "   IF4  ;" },
+            { "   EX2  ;", "   EX3  ;", "   EX4  ;" },
+            { "  MEM2  ;", "  MEM3  ;", "  MEM4  ;" }
+        };
+        if (stages == PipelineTrace::IF) return kSubStageTexts[0][subStage - 1];
+        if (stages == PipelineTrace::EX) return kSubStageTexts[1][subStage - 1];
+        if (stages == PipelineTrace::MEM) return kSubStageTexts[2][subStage - 1];
+    }
+    string cell = kBlankCell;
+    if (stages & PipelineTrace::WB) {
+        cell = "   WB   ;";
+    }
+    if (stages & PipelineTrace::MEM) {
+        cell = "   MEM  ;";
+    }
+    if (stages & PipelineTrace::EX) {
+        cell = (cell == "   WB   ;") ? "  EX/WB ;" : "   EX   ;";
+    }
+    if (stages & PipelineTrace::ID) {
+        if (cell == "   WB   ;") {
+            cell = " ID/WB ;";
+        } else if (cell == "   MEM  ;") {
+            cell = " ID/MEM ;";
+        } else {
+            cell = "   ID   ;";
+        }
+    }
+    if (stages & PipelineTrace::CLEAR) {
+        cell = kBlankCell;
+    }
+    if (stages & PipelineTrace::IF) {
+        if (cell == "   MEM  ;") {
+            cell = " IF/MEM ;";
+        } else if (cell == "   WB   ;") {
+            cell = "  IF/WB ;";
+        } else if (cell == "   EX   ;") {
+            cell = "  IF/EX ;";
+        } else if (cell == "  EX/WB ;") {
+            cell = "IF/EX/WB;";
+        } else {
+            cell = "   IF   ;";
+        }
+    }
+    // Hand out one shared pointer per distinct cell text
+    static const char* const kTexts[] = {
+        kBlankCell, "   WB   ;", "   MEM  ;", "   EX   ;", "  EX/WB ;", "   ID   ;", " ID/WB ;",
+        " ID/MEM ;", "   IF   ;", " IF/MEM ;", "  IF/WB ;", "  IF/EX ;", "IF/EX/WB;"
+    };
+    for (const char* text : kTexts) {
+        if (cell == text) return text;
+    }
+    return kBlankCell;
+}
+
+// Rendered cell for every combination of stage and sub-stage bits
+struct CellTable {
+    const char* cells[256];
+    CellTable() {
+        for (int stages = 0; stages < 256; stages++) {
+            cells[stages] = renderCell(stages);
+        }
+    }
+};
+const CellTable kCells;
+} // namespace
+
+void PipelineTrace::clear(int firstCycle) {
+    first = firstCycle;
+    cycleStart.clear();
+    cells.clear();
+    before.clear();
+}
+
+vector<uint32_t> PipelineTrace::cellsBefore(int cycle) const {
+    if (cycle == first) return before;
+    int index = cycle - 1 - first;
+    if (index < 0 || index + 1 >= static_cast<int>(cycleStart.size())) return {};
+    return vector<uint32_t>(cells.begin() + cycleStart[index], cells.begin() + cycleStart[index + 1]);
+}
+
+void PipelineTrace::setCellsBefore(const vector<uint32_t>& column) {
+    before = column;
+}
+
+void PipelineTrace::startCells(vector<const char*>& prev, size_t rows) const {
+    prev.assign(rows, nullptr);
+    for (uint32_t cell : before) {
+        uint32_t row = cell >> kStageBits;
+        if (row < rows) prev[row] = kCells.cells[cell & kStageMask];
+    }
+}
+
+void PipelineTrace::reserve(int cycles) {
+    // A cycle touches at most five rows (one per stage)
+    cycleStart.reserve(cycles + 1);
+    cells.reserve(5 * static_cast<size_t>(cycles));
+}
+
+void PipelineTrace::mark(uint32_t row, int cycle, uint8_t stage) {
+    if (cycleStart.empty()) {
+        cycleStart.push_back(0);
+    }
+    // Open every cycle up to and including `cycle`
+    int index = cycle - first;
+    while (static_cast<int>(cycleStart.size()) <= index + 1) {
+        cycleStart.push_back(cells.size());
+    }
+    // Merge with a cell already recorded for this row in this cycle
+    for (size_t k = cycleStart[index]; k < cells.size(); k++) {
+        if ((cells[k] >> kStageBits) == row) {
+            // Two copies of a row in a split stage show the later one
+            uint32_t subStage = max<uint32_t>(cells[k] & kSubStageMask, stage & kSubStageMask);
+            cells[k] = ((cells[k] | stage) & ~static_cast<uint32_t>(kSubStageMask)) | subStage;
+            return;
+        }
+    }
+    cells.push_back((row << kStageBits) | stage);
+    cycleStart[index + 1] = cells.size();
+}
+
+void PipelineTrace::discardBefore(int cycle) {
+    int count = cycle - first;
+    if (count <= 0) return;
+    before = cellsBefore(cycle);
+    if (count >= static_cast<int>(cycleStart.size()) - 1) {
+        // Nothing recorded from `cycle` on
+        cycleStart.clear();
+        cells.clear();
+    } else {
+        uint32_t removed = cycleStart[count];
+        cells.erase(cells.begin(), cells.begin() + removed);
+        cycleStart.erase(cycleStart.begin(), cycleStart.begin() + count);
+        for (uint32_t& start : cycleStart) {
+            start -= removed;
+        }
+    }
+    first = cycle;
+}
+
+void PipelineTrace::renderCells(int begin, int end, size_t rows, vector<const char*>& prev, const RowSink& emit) const {
+    // Bucket the cells by row (counting sort), keeping them in cycle order
+    int recorded = first + static_cast<int>(cycleStart.size()) - 1;
+    int from = max(begin, first) - first;
+    int to = min(end, recorded) - first;
+    uint32_t cellBegin = from < to ? cycleStart[from] : 0;
+    uint32_t cellEnd = from < to ? cycleStart[to] : 0;
+    vector<uint32_t> rowStart(rows + 1, 0);
+    for (uint32_t k = cellBegin; k < cellEnd; k++) {
+        uint32_t row = cells[k] >> kStageBits;
+        if (row < rows) rowStart[row + 1]++;
+    }
+    for (size_t r = 0; r < rows; r++) {
+        rowStart[r + 1] += rowStart[r];
+    }
+    vector<uint32_t> fill(rowStart.begin(), rowStart.end() - 1);
+    vector<pair<int, uint8_t>> byRow(rowStart[rows]); // (cycle, stage bits)
+    for (int c = from; c < to; c++) {
+        for (uint32_t k = cycleStart[c]; k < cycleStart[c + 1]; k++) {
+            uint32_t row = cells[k] >> kStageBits;
+            if (row < rows) byRow[fill[row]++] = make_pair(first + c, static_cast<uint8_t>(cells[k] & kStageMask));
+        }
+    }
+
+    size_t width = 9 * static_cast<size_t>(max(end - begin, 0));
+    string blankLine;
+    string line;
+    line.reserve(width);
+    for (size_t r = 0; r < rows; r++) {
+        if (rowStart[r] == rowStart[r + 1]) {
+            // Untouched row: a blank cell never turns into a stall mark
+            if (blankLine.empty()) {
+                for (int c = begin; c < end; c++) blankLine += kBlankCell;
+            }
+            if (end > begin) prev[r] = kBlankCell;
+            emit(r, blankLine, false);
+            continue;
+        }
+        line.clear();
+        uint32_t k = rowStart[r];
+        for (int c = begin; c < end; c++) {
+            const char* stage = kBlankCell;
+            if (k < rowStart[r + 1] && byRow[k].first == c) {
+                stage = kCells.cells[byRow[k++].second];
+            }
+            if (prev[r] != kBlankCell && prev[r] == stage) {
+                line += kStallCell;
+            } else {
+                line += stage;
+            }
+            prev[r] = stage;
+        }
+        emit(r, line, true);
+    }
+}
+
+void PipelineTrace::render(ostream& out, const vector<pair<uint32_t, string>>& labels, int cycles) const {
+    vector<const char*> prev;
+    startCells(prev, labels.size());
+    renderCells(first, cycles, labels.size(), prev, [&](size_t row, const string& text, bool) {
+        // Ensure fixed width (17 characters in this example)
+        out << left << setw(17) << labels[row].second << ":";
+        out << text << endl;
+    });
+}
+
+PipelineStream::~PipelineStream() {
+    clear();
+}
+
+void PipelineStream::clear() {
+    if (spill) {
+        fclose(spill);
+        spill = nullptr;
+    }
+    prev.clear();
+    rangeCycles.clear();
+    segments.clear();
+}
+
+void PipelineStream::flush(PipelineTrace& trace, size_t rows, int cycle) {
+    int begin = trace.firstCycle();
+    if (cycle <= begin) return;
+    if (!spill) {
+        spill = tmpfile();
+        if (!spill) {
+            return; // Keep everything in the trace instead
+        }
+    }
+    if (prev.empty()) {
+        trace.startCells(prev, rows);
+    }
+    fseeko(spill, 0, SEEK_END);
+    uint64_t offset = ftello(spill);
+    trace.renderCells(begin, cycle, rows, prev, [&](size_t, const string& text, bool touched) {
+        Segment segment;
+        if (touched) {
+            segment.offset = offset;
+            segment.length = text.size();
+            fwrite(text.data(), 1, text.size(), spill);
+            offset += text.size();
+        }
+        segments.push_back(segment);
+    });
+    rangeCycles.push_back(cycle - begin);
+    trace.discardBefore(cycle);
+}
+
+void PipelineStream::skip(PipelineTrace& trace, size_t rows, int cycle) {
+    if (prev.empty()) {
+        trace.startCells(prev, rows);
+    }
+    trace.renderCells(trace.firstCycle(), cycle, rows, prev, [](size_t, const string&, bool) {});
+    trace.discardBefore(cycle);
+}
+
+void PipelineStream::finish(ostream& out, PipelineTrace& trace, const vector<pair<uint32_t, string>>& labels, int cycles) {
+    if (!spill && prev.empty()) {
+        // Short run: nothing was spilled
+        trace.render(out, labels, cycles);
+        return;
+    }
+    flush(trace, labels.size(), cycles);
+    if (!spill) {
+        trace.render(out, labels, cycles); // No spill file could be created
+        return;
+    }
+    fflush(spill);
+
+    size_t rows = labels.size();
+    string text;
+    for (size_t r = 0; r < rows; r++) {
+        out << left << setw(17) << labels[r].second << ":";
+        for (size_t range = 0; range < rangeCycles.size(); range++) {
+            const Segment& segment = segments[range * rows + r];
+            if (segment.length == 0) {
+                for (int c = 0; c < rangeCycles[range]; c++) out << kBlankCell;
+                continue;
+            }
+            text.resize(segment.length);
+            fseeko(spill, segment.offset, SEEK_SET);
+            if (fread(&text[0], 1, segment.length, spill) != segment.length) {
+                cerr << "Error reading the pipeline spill file" << endl;
+                return;
+            }
+            out << text;
+        }
+        out << '\n';
+    }
+    out.flush();
+}
+
+string Processor::outputFileName(const string& inputFile, bool forwardingEnabled) const {
     // Extract the base name from inputFile (simple extraction assuming no directories in inputFile)
     size_t pos = inputFile.find_last_of("/\\");
     string baseFilename = (pos == string::npos) ? inputFile : inputFile.substr(pos + 1);
@@ -276,8 +998,16 @@ void Processor::print_pipeline(int cycles, bool forwardingEnabled, const string&
         baseFilename = baseFilename.substr(0, pos);
 
     // Construct output file name based on forwarding flag
-    string outputFileName = "../outputfiles/" + baseFilename;
+    string outputFileName = outputDirectory + baseFilename;
+    if (hartCount > 1) {
+        outputFileName += "_hart" + to_string(hartId);
+    }
     outputFileName += (forwardingEnabled ? "_forward_out.txt" : "_noforward_out.txt");
+    return outputFileName;
+}
+
+void Processor::print_pipeline(int cycles, bool forwardingEnabled, const string& inputFile) {
+    string outputFileName = this->outputFileName(inputFile, forwardingEnabled);
 
     // Open the output file stream
     ofstream outFile(outputFileName);
@@ -285,105 +1015,171 @@ void Processor::print_pipeline(int cycles, bool forwardingEnabled, const string&
         cerr << "Error opening file: " << outputFileName << endl;
         return;
     }
+    writePipeline(outFile, cycles);
+    outFile.close();
+}
 
-    // Print cycle header into file
-    outFile << "Cycle Count      :";
-    for (int i = 0; i < cycles; i++) {
+void Processor::setStreamWindow(int window) {
+    if (window > 0) {
+        pipelineStream.reset(new PipelineStream(window));
+        // The trace only ever holds one window
+        pipelineTrace.reserve(window);
+    } else {
+        pipelineStream.reset();
+    }
+}
+
+void writeCycleHeader(ostream& out, int begin, int end) {
+    out << "Cycle Count      :";
+    for (int i = begin; i < end; i++) {
         if (i < 10) {
-            outFile << "    " << i << "    ";
+            out << "    " << i << "    ";
         } else if (i < 100) {
-            outFile << "   " << i << "    ";
+            out << "   " << i << "    ";
         } else {
-            outFile << "   " << i << "   ";
+            out << "   " << i << "   ";
         }
     }
-    outFile << endl;
-    // Print pipeline matrix 
-    for (const auto& entry : pipelineMatrix) {
-        // Use the instruction string from instructionLines map
-        string instrStr = instructionLines[entry.first].second;
-        // Ensure fixed width (17 characters in this example)
-        outFile << left << setw(17) << instrStr << ":";
-        string prev = "";
-        for (const auto& stage : entry.second) {
-            if (prev != "        ;" && prev == stage) {
-                outFile << "   -    ;";
-            } else {
-                outFile << stage;
-            }
-            prev = stage;
-        }
-        outFile << endl;
-    }
-    // cout << "\nRegister Values:" << endl;
-    // for (int i = 0; i < 32; i++) {
-    //     cout << "x" << i << " = " << getRegister(i);
-    //     // Print in columns of 4 registers per line
-    //     if (i % 4 == 3 || i == 31) {
-    //         cout << endl;
-    //     } else {
-    //         cout << "\t";
-    //     }
-    // }
-    outFile.close();
+    out << endl;
 }
 
-void Processor::loadInstructions(const string& filename, const int cyclecount) {
-    ifstream inputFile(filename);
-    if (!inputFile.is_open()) {
-        cerr << "Error: Could not open file " << filename << endl;
-        exit(1);
+void Processor::writePipeline(ostream& out, int cycles) {
+    // Print cycle header into file
+    writeCycleHeader(out, startCycle, cycles);
+    // Print pipeline matrix
+    if (pipelineStream) {
+        pipelineStream->finish(out, pipelineTrace, instructionLines, cycles);
+    } else {
+        pipelineTrace.render(out, instructionLines, cycles);
     }
+}
 
-    string line;
-    uint32_t address = 0;
-    while (getline(inputFile, line)) {
-        if (line.empty()) continue;
-        
-        // Parse the instruction line from file.
-        istringstream iss(line);
-        string hexCode;
-        iss >> hexCode;
-        string fullInstruction;
-        getline(iss, fullInstruction); // Get the remainder of the line.
-
-        // Trim whitespace, newline, and carriage return characters.
-        const string whitespace = " \t\r\n";
-        size_t start = fullInstruction.find_first_not_of(whitespace);
-        if (start != string::npos) {
-            fullInstruction = fullInstruction.substr(start);
-        }
-        size_t end = fullInstruction.find_last_not_of(whitespace);
-        if (end != string::npos) {
-            fullInstruction = fullInstruction.substr(0, end + 1);
+const char* hazardName(HazardType type) {
+    static const char* const kHazardNames[PipelineStats::kHazardTypes] = {
+        "none", "load_use", "load_store_base", "alu_branch", "alu_jalr",
+        "load_branch", "load_jalr", "raw_ex", "raw_mem", "raw_wb", "muldiv_result", "muldiv_busy", "alu_use",
+        "bundle_raw", "pairing", "rob_full", "issue_queue_full", "lsq_full", "no_free_register"
+    };
+    return kHazardNames[static_cast<int>(type)];
+}
+
+namespace {
+// JSON string literal of text
+string jsonString(const string& text) {
+    string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') quoted += '\\';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+
+// Counters of a cache as a JSON object
+void writeCacheStats(ostream& out, const Cache& cache, uint64_t stallCycles) {
+    uint64_t accesses = cache.reads + cache.writes;
+    uint64_t misses = cache.readMisses + cache.writeMisses;
+    out << "{\"config\": " << jsonString(cache.getConfig().describe())
+        << ", \"reads\": " << cache.reads << ", \"writes\": " << cache.writes
+        << ", \"read_misses\": " << cache.readMisses << ", \"write_misses\": " << cache.writeMisses
+        << ", \"writebacks\": " << cache.writebacks
+        << ", \"hit_rate\": " << (accesses ? double(accesses - misses) / accesses : 0.0)
+        << ", \"stall_cycles\": " << stallCycles << "}";
+}
+} // namespace
+
+void Processor::writeStats(ostream& out) const {
+    out << "{\n";
+    if (hartCount > 1) {
+        out << "  \"hart\": " << hartId << ",\n";
+    }
+    out << "  \"forwarding\": " << (forwardingEnabled ? "true" : "false") << ",\n";
+    if (depth != PipelineDepth()) {
+        out << "  \"depth\": {\"config\": " << jsonString(depth.describe()) << ", \"stages\": " << depth.stages() << "},\n";
+    }
+    out << "  \"cycles\": " << stats.cycles << ",\n";
+    out << "  \"retired\": " << stats.retired << ",\n";
+    if (issueWidth > 1) {
+        // Cycles by the number of instructions ID issued in them
+        out << "  \"issue\": {\"width\": " << issueWidth << ", \"ipc\": "
+            << (stats.cycles ? double(stats.retired) / stats.cycles : 0.0) << ", \"groups\": [";
+        for (uint32_t size = 0; size <= issueWidth; size++) {
+            out << (size ? ", " : "") << stats.issueGroups[size];
         }
-        
-        // Remove content enclosed in '<' and '>' if it exists.
-        size_t anglePos = fullInstruction.find('<');
-        if (anglePos != string::npos) {
-            size_t endPos = fullInstruction.find('>', anglePos);
-            if (endPos != string::npos) {
-                fullInstruction.erase(anglePos, endPos - anglePos + 1);
-                // Trim again after removal.
-                start = fullInstruction.find_first_not_of(whitespace);
-                if (start != string::npos) {
-                    fullInstruction = fullInstruction.substr(start);
-                }
-                end = fullInstruction.find_last_not_of(whitespace);
-                if (end != string::npos) {
-                    fullInstruction = fullInstruction.substr(0, end + 1);
-                }
-            }
+        out << "]},\n";
+    }
+    if (outOfOrderCore) {
+        outOfOrderCore->writeStats(out);
+    }
+    out << "  \"cpi\": " << (stats.retired ? double(stats.cycles) / stats.retired : 0.0) << ",\n";
+    out << "  \"bubbles\": " << stats.bubbles() << ",\n";
+    out << "  \"flushes\": " << stats.flushes << ",\n";
+    if (dataCache) {
+        out << "  \"dcache\": ";
+        writeCacheStats(out, *dataCache, stats.memoryStalls);
+        out << ",\n";
+    }
+    out << "  \"branches\": {\"predictor\": "
+        << jsonString(branchPredictor ? branchPredictor->getConfig().describe() : "none")
+        << ", \"conditional\": " << stats.branches << ", \"taken\": " << stats.takenBranches
+        << ", \"jumps\": " << stats.jumps << ", \"mispredictions\": " << stats.mispredictions
+        << ", \"accuracy\": " << (stats.branches + stats.jumps ? 1.0 - double(stats.mispredictions) / (stats.branches + stats.jumps) : 0.0)
+        << "},\n";
+    if (instructionCache) {
+        out << "  \"icache\": ";
+        writeCacheStats(out, *instructionCache, stats.fetchStalls);
+        out << ",\n";
+    }
+    if (mulDivUnit) {
+        out << "  \"muldiv\": {\"config\": " << jsonString(mulDivUnit->getConfig().describe())
+            << ", \"mul\": " << mulDivUnit->multiplies << ", \"div\": " << mulDivUnit->divides
+            << ", \"rem\": " << mulDivUnit->remainders
+            << ", \"stall_cycles\": " << stats.stalls[static_cast<int>(HazardType::MULDIV_RESULT)] +
+                                          stats.stalls[static_cast<int>(HazardType::MULDIV_BUSY)] << "},\n";
+    }
+    out << "  \"stalls\": {\"total\": " << stats.totalStalls();
+    for (int type = 1; type < PipelineStats::kHazardTypes; type++) {
+        out << ", \"" << hazardName(static_cast<HazardType>(type)) << "\": " << stats.stalls[type];
+    }
+    out << "},\n";
+    // Only the instructions that stalled, with the causes they stalled for
+    out << "  \"stalls_by_pc\": [";
+    const char* separator = "";
+    for (size_t row = 0; row < instructionLines.size(); row++) {
+        const uint64_t* counts = &stats.stallsByRow[row * PipelineStats::kHazardTypes];
+        uint64_t total = 0;
+        for (int type = 0; type < PipelineStats::kHazardTypes; type++) total += counts[type];
+        if (total == 0) continue;
+        out << separator << "\n    {\"pc\": " << instructionLines[row].first
+            << ", \"instruction\": " << jsonString(instructionLines[row].second)
+            << ", \"total\": " << total;
+        for (int type = 1; type < PipelineStats::kHazardTypes; type++) {
+            if (counts[type]) out << ", \"" << hazardName(static_cast<HazardType>(type)) << "\": " << counts[type];
         }
+        out << "}";
+        separator = ",";
+    }
+    out << (*separator ? "\n  ]\n" : "]\n");
+    out << "}" << endl;
+}
 
-        // Convert hex to binary.
-        uint32_t binInstruction = stoul(hexCode, nullptr, 16);
-        // Store in memory.
-        instructionMemory[address] = binInstruction;
-        pipelineMatrix[(address / 4)] = vector<string>(cyclecount, "        ;");
-        // Store the full instruction string.
-        instructionLines.push_back(make_pair(address, fullInstruction));
-        address += 4; // Each instruction is 4 bytes.
+shared_ptr<const DecodedProgram> DecodedProgram::load(const string& filename, string& error) {
+    ProgramImage image;
+    if (!loadProgramImage(filename, image, error)) {
+        return nullptr;
+    }
+    // Decode once and keep the text of every instruction for the diagram
+    auto program = make_shared<DecodedProgram>();
+    program->textBase = image.base;
+    program->instructions.reserve(image.words.size());
+    program->lines.reserve(image.words.size());
+    for (size_t i = 0; i < image.words.size(); i++) {
+        program->instructions.push_back(InstructionDecode::decode(image.words[i]));
+        program->lines.emplace_back(image.base + 4 * i, move(image.text[i])); // Each instruction is 4 bytes
     }
-    inputFile.close();
+    program->executable = image.executable;
+    program->entry = image.entry;
+    program->globalPointer = image.globalPointer;
+    program->segments = move(image.segments);
+    return program;
 }
\ No newline at end of file
@@ -7,16 +7,20 @@
 #include <vector>
 #include <map>
 #include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include "Memory.hpp"
+#include "Cache.hpp"
+#include "BranchPredictor.hpp"
+#include "MulDivUnit.hpp"
+#include "Loader.hpp"
+#include "Sampling.hpp"
+#include "Trace.hpp"
+#include "OutOfOrder.hpp"
 
 using namespace std;
 
-// Base class for pipeline stages
-class PipelineStage {
-    public:
-        virtual void process(const int i = 0) = 0;
-        virtual ~PipelineStage() {}
-    };
-    
 class Processor;
 
 
@@ -43,64 +47,287 @@ struct ControlSignals {
     int aluOp = 0; // What operation ALU should perform
 };
 
+// Instruction decoded once when the program is loaded, so that the stages
+// read the fields instead of extracting them from the raw word every cycle
+struct DecodedInstruction {
+    uint32_t instruction = 0; // Raw machine code (0 for no instruction)
+    uint32_t opcode = 0;
+    InstructionType type = InstructionType::UNKNOWN;
+    ControlSignals signals;
+    int32_t immediate = 0;
+    uint32_t rs1 = 0;
+    uint32_t rs2 = 0; // 0 for I-type instructions, which have no rs2
+    uint32_t rd = 0;
+    uint32_t funct3 = 0;
+    uint32_t funct7 = 0;
+    uint32_t aluControl = 0; // ALU operation selected in the EX stage
+};
+
+// Record used for addresses outside the program and empty pipeline registers
+extern const DecodedInstruction kNoInstruction;
+
+// A program as the simulator runs it: decoded once when it is loaded, with
+// the diagram label of every instruction and, for an ELF executable, its
+// initial state. Nothing changes it afterwards, so any number of
+// Processors, also on different threads, can share one copy.
+struct DecodedProgram {
+    uint32_t textBase = 0;                   // Address of the first instruction
+    vector<DecodedInstruction> instructions; // Indexed by (pc - textBase) / 4
+    vector<pair<uint32_t, string>> lines;    // pc and diagram label of every instruction
+    bool executable = false;                 // Loaded from an ELF executable; then:
+    uint32_t entry = 0;                      // Initial pc
+    uint32_t globalPointer = 0;              // Initial gp
+    vector<ProgramImage::Segment> segments;  // Initial data memory
+
+    // Load and decode filename (see loadProgramImage); nullptr and error on failure
+    static shared_ptr<const DecodedProgram> load(const string& filename, string& error);
+};
+
+// Reason ID holds an instruction for a cycle
+enum class HazardType : uint8_t {
+    NONE,
+    LOAD_USE,        // Operand loaded by the instruction in EX
+    LOAD_STORE_BASE, // Store address base loaded by the instruction in EX
+    ALU_BRANCH,      // Branch operand computed by the instruction in EX
+    ALU_JALR,        // JALR base computed by the instruction in EX
+    LOAD_BRANCH,     // Branch operand loaded by the instruction in MEM
+    LOAD_JALR,       // JALR base loaded by the instruction in MEM
+    RAW_EX,          // No forwarding: operand written by the instruction in EX
+    RAW_MEM,         // ... in MEM
+    RAW_WB,          // ... in WB
+    MULDIV_RESULT,   // Operand or rd waits for a result of the multiplier/divider
+    MULDIV_BUSY,     // Iterative multiplier/divider still busy with an older operation
+    ALU_USE,         // Operand computed by an instruction still in a later execute stage
+    BUNDLE_RAW,      // Wide issue: operand written by an older instruction issuing in the same cycle
+    PAIRING,         // Wide issue: a pairing rule keeps it out of the older instructions' issue group
+    ROB_FULL,        // Out-of-order core: rename waits for a reorder buffer entry
+    ISSUE_QUEUE_FULL, // ... for an issue queue entry
+    LSQ_FULL,        // ... for a load/store queue entry
+    NO_FREE_REGISTER, // ... for a free physical register
+    COUNT
+};
+
+// Event counters of one run, cleared by Processor::reset(). Each event is a
+// single increment where it happens in the stages.
+struct PipelineStats {
+    static constexpr int kHazardTypes = static_cast<int>(HazardType::COUNT);
+    static constexpr uint32_t kMaxIssueWidth = 4;
+
+    uint64_t cycles = 0;
+    uint64_t retired = 0; // Instructions that left WB
+    uint64_t flushes = 0; // Fetched instructions squashed by a taken branch or jump
+    uint64_t memoryStalls = 0; // Cycles MEM waited for the data cache
+    uint64_t fetchStalls = 0;  // Cycles IF waited for the instruction cache
+    uint64_t branches = 0;      // Conditional branches resolved in ID
+    uint64_t takenBranches = 0;
+    uint64_t jumps = 0;         // JAL/JALR resolved in ID
+    uint64_t mispredictions = 0; // Branches and jumps that redirected fetch
+    uint64_t stalls[kHazardTypes] = {}; // Cycles ID held an instruction, by cause
+    vector<uint64_t> stallsByRow;       // The same per static instruction, kHazardTypes per row
+    uint64_t issueGroups[kMaxIssueWidth + 1] = {}; // Wide issue: cycles in which ID issued 0, 1, ... instructions
+    uint64_t coRetired = 0; // Wide issue: instructions that left WB in the same cycle as an older one
+
+    void clear(size_t rows) {
+        *this = PipelineStats();
+        stallsByRow.assign(rows * kHazardTypes, 0);
+    }
+    void countStall(HazardType type, uint32_t row) {
+        stalls[static_cast<int>(type)]++;
+        size_t index = static_cast<size_t>(row) * kHazardTypes + static_cast<int>(type);
+        if (index < stallsByRow.size()) stallsByRow[index]++;
+    }
+    uint64_t totalStalls() const {
+        uint64_t total = 0;
+        for (uint64_t count : stalls) total += count;
+        return total;
+    }
+    // Cycles in which no instruction left WB (pipeline fill, stalls, flushes, drain)
+    uint64_t bubbles() const { return cycles - (retired - coRetired); }
+};
+
+// Name of a stall cause in the JSON output, e.g. "load_use"
+const char* hazardName(HazardType type);
+
 struct hazard_detection {
     bool is_hazard = false;
 };
 
+// Compact record of the pipeline diagram: for every cycle only the rows (static
+// instructions) that some stage touched are stored, each as a bitmask of stages.
+// The text cells are produced from the masks only when the diagram is printed.
+class PipelineTrace {
+public:
+    // Stage bits, listed in the order the stages run within a cycle (WB first)
+    enum Stage : uint8_t {
+        WB = 1 << 0,
+        MEM = 1 << 1,
+        EX = 1 << 2,
+        ID = 1 << 3,
+        CLEAR = 1 << 4, // ID found a flushed IF/ID and blanked the cell
+        IF = 1 << 5
+    };
+    // Bits 6-7 of a mark number the stage within a split fetch, execute or
+    // memory stage (see PipelineDepth): IF | subStage(1) is the second fetch stage
+    static constexpr int kSubStageShift = 6;
+    static constexpr uint8_t kSubStageMask = 3 << kSubStageShift;
+    static uint8_t subStage(uint32_t index) { return index << kSubStageShift; }
+
+    // Forget every cycle; the next marks start at firstCycle
+    void clear(int firstCycle = 0);
+    // Cells of `cycle` - 1, the column the stall marks of `cycle` are
+    // relative to (empty when nothing touched it or it is not known)
+    vector<uint32_t> cellsBefore(int cycle) const;
+    // Continue a diagram: the cells of the cycle before firstCycle, as
+    // returned by cellsBefore, after clear(firstCycle)
+    void setCellsBefore(const vector<uint32_t>& before);
+    void reserve(int cycles);
+    // Record that `stage` touched instruction `row` during `cycle`.
+    // Cycles must be marked in non-decreasing order.
+    void mark(uint32_t row, int cycle, uint8_t stage);
+    // Write one line per row, `cycles` cells wide, into out
+    void render(ostream& out, const vector<pair<uint32_t, string>>& labels, int cycles) const;
+
+    // Cells of cycles [begin, end) of every row: emit(row, text, touched) is
+    // called for the rows in order, touched being false when no stage touched
+    // the row (all cells blank). prev holds the last cell of every row
+    // (nullptr before the first call) and carries the stall marks over.
+    typedef function<void(size_t, const string&, bool)> RowSink;
+    void renderCells(int begin, int end, size_t rows, vector<const char*>& prev, const RowSink& emit) const;
+    // Forget every cycle before `cycle`; marks must not go back to them
+    void discardBefore(int cycle);
+    int firstCycle() const { return first; }
+    // Initial prev for renderCells: the cells of the cycle before firstCycle()
+    void startCells(vector<const char*>& prev, size_t rows) const;
+
+private:
+    static constexpr int kStageBits = 8;
+    static constexpr uint32_t kStageMask = (1u << kStageBits) - 1;
+
+    int first = 0;               // Cycles before this one were discarded
+    vector<uint32_t> cycleStart; // Index of the first cell of each cycle (from first) in cells
+    vector<uint32_t> cells;      // (row << kStageBits) | stage and sub-stage bits
+    vector<uint32_t> before;     // Cells of the cycle before first
+};
+
+// Writes the diagram of a long run with bounded memory. The completed cycles
+// are regularly rendered row by row into a temporary spill file and dropped
+// from the trace; finish() renders the rest and assembles every row of the
+// diagram from its pieces.
+class PipelineStream {
+public:
+    static constexpr int kDefaultWindow = 4096;
+
+    explicit PipelineStream(int window) : window(window) {}
+    ~PipelineStream();
+    PipelineStream(const PipelineStream&) = delete;
+    PipelineStream& operator=(const PipelineStream&) = delete;
+
+    // Cycles simulated between two spills
+    int getWindow() const { return window; }
+    // Spill the cycles of trace before `cycle`, which no stage can touch any more
+    void flush(PipelineTrace& trace, size_t rows, int cycle);
+    // Drop the cycles of trace before `cycle` without writing them; the
+    // cells that follow still show stall marks relative to the last of them
+    void skip(PipelineTrace& trace, size_t rows, int cycle);
+    // Write one line per row, `cycles` cells wide, into out
+    void finish(ostream& out, PipelineTrace& trace, const vector<pair<uint32_t, string>>& labels, int cycles);
+    // Drop everything spilled so far
+    void clear();
+
+private:
+    // Text of one row within one spilled range of cycles
+    struct Segment {
+        uint64_t offset = 0;
+        uint32_t length = 0; // 0: the row was not touched, every cell is blank
+    };
+
+    int window;
+    FILE* spill = nullptr;
+    vector<const char*> prev;  // Last cell of every row
+    vector<int> rangeCycles;   // Cycles in every spilled range
+    vector<Segment> segments;  // Per range, one per row
+};
+
 // Instruction Fetch stage class
-class InstructionFetch : public PipelineStage {
+class InstructionFetch {
 private:
     Processor* processor;
+    // Drop what was fetched after a taken branch or jump (fetchedNow: IF/ID
+    // was fetched this cycle); returns the number of instructions dropped
+    template <typename Policy>
+    uint32_t squashFetched(bool fetchedNow);
 public:
     InstructionFetch(Processor* proc) : processor(proc) {}
-    void process(const int i) override;
+    // Stages are instantiated per forwarding policy (see Pipeline.hpp)
+    template <typename Policy>
+    void process(const int i);
+    // Wide pipeline: fetch the next bundle, one instruction per slot
+    template <typename Policy>
+    void processWide(const int i);
 };
 
 // Instruction Decode stage class
-class InstructionDecode : public PipelineStage {
+class InstructionDecode {
 private:
     Processor* processor;
 
-    // Helper methods
-    InstructionType getInstructionType(uint32_t instruction);
-    int32_t extractImmediate(uint32_t instruction, InstructionType type);
-    ControlSignals generateControlSignals(uint32_t instruction);
-
 public:
     InstructionDecode(Processor* proc) : processor(proc) {}
-    void process(const int i) override;
+    // Stages are instantiated per forwarding policy (see Pipeline.hpp)
+    template <typename Policy>
+    void process(const int i);
+    // Wide pipeline: issue the bundle in IF/ID slot by slot, oldest first
+    template <typename Policy>
+    void processWide(const int i);
+
+    // Helper methods
+    static InstructionType getInstructionType(uint32_t instruction);
+    static int32_t extractImmediate(uint32_t instruction, InstructionType type);
+    static ControlSignals generateControlSignals(uint32_t instruction);
+    // Extract every field the pipeline needs from one instruction word
+    static DecodedInstruction decode(uint32_t instruction);
+    // Condition of the conditional branch with this funct3 on operands a, b;
+    // the one definition shared by ID, the functional model and the
+    // out-of-order core
+    static bool branchTaken(uint32_t funct3, int32_t a, int32_t b);
 };
 
 // Execute stage class
-class Execute : public PipelineStage {
+class Execute {
 private:
     Processor* processor;
 
-    // Helper methods
-    uint32_t getALUControl(uint32_t aluOp, uint32_t funct3, uint32_t funct7);
-    uint32_t performALU(uint32_t aluControl, uint32_t input1, uint32_t input2, bool& zero);
-
 public:
     Execute(Processor* proc) : processor(proc) {}
-    void process(const int i) override;
+    // Stages are instantiated per forwarding policy (see Pipeline.hpp)
+    template <typename Policy>
+    void process(const int i);
+
+    // Helper methods
+    static uint32_t getALUControl(uint32_t aluOp, uint32_t funct3, uint32_t funct7);
+    static uint32_t performALU(uint32_t aluControl, uint32_t input1, uint32_t input2, bool& zero);
 };
 
 // Memory Access stage class
-class MemoryAccess : public PipelineStage {
+class MemoryAccess {
 private:
     Processor* processor;
 public:
     MemoryAccess(Processor* proc) : processor(proc) {}
-    void process(const int i) override;
+    // Stages are instantiated per forwarding policy (see Pipeline.hpp)
+    template <typename Policy>
+    void process(const int i);
 };
 
 // Write Back stage class
-class WriteBack : public PipelineStage {
+class WriteBack {
 private:
     Processor* processor;
 public:
     WriteBack(Processor* proc) : processor(proc) {}
-    void process(const int i) override;
+    // Stages are instantiated per forwarding policy (see Pipeline.hpp)
+    template <typename Policy>
+    void process(const int i);
 };
 
 // Struct for WB control signals passed between pipeline registers
@@ -137,7 +364,10 @@ struct IF_ID_Register {
     uint32_t rd = 0;
     hazard_detection hazard; // Placeholder
     uint32_t pc = 0;
+    uint32_t predictedNext = 0; // Address IF fetched after this instruction
     uint32_t instruction = 0;
+    const DecodedInstruction* decoded = &kNoInstruction;
+    uint64_t seq = 0; // Dynamic instruction number given by IF (see Processor::fetchSeq)
     bool isStall = false;
 };
 
@@ -155,6 +385,8 @@ struct ID_EX_Register {
     uint32_t rs1 = 0;
     uint32_t rs2 = 0;
     uint32_t instruction = 0;
+    const DecodedInstruction* decoded = &kNoInstruction;
+    uint64_t seq = 0; // Dynamic instruction number given by IF (see Processor::fetchSeq)
     bool isStall = false;
 };
 
@@ -166,10 +398,13 @@ struct EX_MEM_Register {
     bool zero = false;
     int32_t aluResult = 0;
     int32_t readData2 = 0;
+    uint32_t funct3 = 0; // Selects the access width of loads/stores
     uint32_t rd = 0;
     uint32_t rs1 = 0;
     uint32_t rs2 = 0;
     uint32_t instruction = 0;
+    const DecodedInstruction* decoded = &kNoInstruction;
+    uint64_t seq = 0; // Dynamic instruction number given by IF (see Processor::fetchSeq)
     bool isStall = false;
 };
 
@@ -180,77 +415,419 @@ struct MEM_WB_Register {
     int32_t aluResult = 0;
     uint32_t rd = 0;
     uint32_t instruction = 0;
+    const DecodedInstruction* decoded = &kNoInstruction;
+    uint64_t seq = 0; // Dynamic instruction number given by IF (see Processor::fetchSeq)
     bool isStall = false;
 };
 
+// One lane of the pipeline: the pipeline registers and split-stage lines of
+// the instructions fetched into it. A wide pipeline (see
+// Processor::setIssueWidth) has one slot per instruction it issues in a
+// cycle; slot 0 holds the oldest instruction of each group.
+struct PipelineSlot {
+    IF_ID_Register if_id;
+    ID_EX_Register id_ex;
+    EX_MEM_Register ex_mem;
+    MEM_WB_Register mem_wb;
+    // Stages after the first of a split fetch, execute or memory stage (see
+    // PipelineDepth), each holding what its predecessor passed on last
+    // cycle; the latch after the stage takes the output of the last one
+    vector<IF_ID_Register> fetchLine;      // Fetch stages 2 on
+    vector<EX_MEM_Register> executeLine;   // Execute stages 2 on
+    vector<MEM_WB_Register> memoryLine;    // Memory stages 2 on
+    HazardType hazardInID = HazardType::NONE; // Found by checkForHazards() this cycle
+};
+
+// Wall-clock time spent in each part of a cycle, collected when a Processor
+// is given one (see Processor::setStageTimes)
+struct StageTimes {
+    enum Part { HAZARDS, WB, MEM, EX, ID, IF, kParts };
+    double seconds[kParts] = {};
+};
+
+// "Cycle Count      :" line heading the diagram of cycles [begin, end)
+void writeCycleHeader(ostream& out, int begin, int end);
+
+// Number of stages fetch, execute and memory access are split into, e.g.
+// "2:2:2" (fetch:execute:memory) for IF1 IF2 ID EX1 EX2 MEM1 MEM2 WB. The
+// first stage of each does all of its work; the others only carry the
+// instruction on, so that a redirect squashes more fetched instructions and
+// a result becomes available that many stages later: an ALU result at the
+// end of the last execute stage, loaded data at the end of the last memory
+// stage. The default 1:1:1 is the five-stage pipeline.
+struct PipelineDepth {
+    static constexpr uint32_t kMaxStages = 4; // Per part (the diagram numbers up to 4)
+    uint32_t fetch = 1;
+    uint32_t execute = 1;
+    uint32_t memory = 1;
+
+    // Parse the string form; returns false on malformed values
+    static bool parse(const string& text, PipelineDepth& depth);
+    string describe() const;
+    uint32_t stages() const { return fetch + execute + memory + 2; }
+    // Results take longer than in the five-stage pipeline to become available
+    bool deepBackend() const { return execute > 1 || memory > 1; }
+    bool operator==(const PipelineDepth& other) const {
+        return fetch == other.fetch && execute == other.execute && memory == other.memory;
+    }
+    bool operator!=(const PipelineDepth& other) const { return !(*this == other); }
+};
+
+// Command line shared by the forward and noforward simulators
+struct RunOptions {
+    string inputFile;
+    int cycles = 0;            // Cycles to simulate, or the safety cap in halt mode
+    bool untilHalt = false;    // Stop once the program has finished
+    bool forwarding = true;    // Simulate the processor with forwarding paths
+    bool functional = false;   // Execute without the pipeline model; cycles caps instructions
+    uint64_t fastForward = 0;  // Instructions executed functionally before the pipeline starts
+    bool stats = false;        // Print the hazard/stall counters as JSON after the run
+    string restoreCheckpoint;  // Start from this checkpoint instead of cycle 0
+    string saveCheckpoint;     // Write a checkpoint of the state the run ends in
+    bool dataCacheEnabled = false;
+    CacheConfig dataCache;     // L1 data cache in front of MEM, if enabled
+    bool instructionCacheEnabled = false;
+    CacheConfig instructionCache; // L1 instruction cache in front of IF, if enabled
+    PredictorConfig predictor; // Next-fetch prediction in IF (none by default)
+    bool mulDivEnabled = false;
+    MulDivConfig mulDiv;       // Multi-cycle mul/div/rem, if enabled
+    PipelineDepth depth;       // Five stages by default
+    uint32_t width = 1;        // Instructions issued per cycle
+    bool outOfOrderEnabled = false;
+    OutOfOrderConfig outOfOrder; // Out-of-order core instead of the pipeline, if enabled
+    bool sampled = false;      // Sampled simulation; cycles caps instructions
+    SamplingConfig sampling;
+    string traceFile;          // Binary per-instruction trace of the run, if set
+    uint32_t harts = 1;        // Cores running the program over a shared memory
+    int quantum = 0;           // Harts on host threads, synchronized every quantum cycles; 0: lock-step
+};
+
+// Parse "<input_file> <cycle_count|halt> [options]"; prints usage and
+// returns false on malformed arguments
+bool parseRunOptions(int argc, char* argv[], RunOptions& options);
+
 // Class representing a RISC-V processor with forwarding
 class Processor {
 private:
     int32_t registers[32] = { 0 }; // RISC-V has 32 registers
-    map<uint32_t, uint32_t> memory; // Memory is sparse, so using a map
+    DataMemory memory; // Sparse paged memory
     uint32_t pc = 0; // Program counter
 
-    // Pipeline registers
-    IF_ID_Register if_id;
-    ID_EX_Register id_ex;
-    EX_MEM_Register ex_mem;
-    MEM_WB_Register mem_wb;
+    // Pipeline registers, one set per issue slot. The stages work on the
+    // selected slot (see selectSlot); slot 0 unless the pipeline is wide.
+    PipelineSlot slots[PipelineStats::kMaxIssueWidth];
+    PipelineSlot* slot = slots;
+    uint32_t issueWidth = 1;
+    PipelineDepth depth;
+
+    template <typename Latch>
+    static Latch& advance(vector<Latch>& line, Latch& latch) {
+        if (line.empty()) return latch;
+        latch = line.back();
+        for (size_t stage = line.size() - 1; stage > 0; stage--) {
+            line[stage] = line[stage - 1];
+        }
+        return line[0];
+    }
+    // Call visit(distance, seq, rd, instruction, value) for every instruction
+    // past ID that writes a register, distance counting the latches from
+    // ID/EX (0) to MEM/WB (execute stages + memory stages) and value being
+    // its result so far; every slot at one distance before the next
+    template <typename Visit>
+    void forEachWriter(Visit visit) const;
 
     // Forwarding unit
     ForwardingSignals forwarding;
 
-    // Storage for instructions loaded from file
-    vector<pair<uint32_t, string>> instructionLines; // Raw instruction lines from file
-    map<uint32_t, uint32_t> instructionMemory; // Decoded instructions
+    // Program being run, possibly shared with other Processors
+    shared_ptr<const DecodedProgram> program;
+    const vector<pair<uint32_t, string>>& instructionLines; // Diagram labels (program->lines)
+    const vector<DecodedInstruction>& instructionMemory;    // Decoded instructions (program->instructions)
+    uint32_t textBase = 0; // Address of the first instruction
+
+    // Initial pc, sp and gp; all 0 for listings, set from an ELF executable
+    uint32_t entryPoint = 0;
+    uint32_t initialSP = 0;
+    uint32_t initialGP = 0;
 
     bool isBranch = false; // Flag to indicate if current instruction is a branch
     uint32_t branchTarget = 0; // Target address if branch is taken
 
-    struct PipelineEntry {
-        string instruction;    // Instruction text (e.g., "addi")
-        vector<string> stages; // Stages at each cycle (IF, ID, EX, etc.)
-    };
-    vector<PipelineEntry> pipelineTrace;
-    int currentCycle = 0;
+    int currentCycle = 0; // Index of the next cycle to simulate
+    int startCycle = 0;   // Cycle the diagram starts at: 0, or that of a restored checkpoint
+    bool forwardingEnabled = true;
+    uint32_t hartId = 0;    // Index of this core among hartCount sharing its memory
+    uint32_t hartCount = 1;
+    string outputDirectory = "../outputfiles/"; // Where print_pipeline writes, with trailing '/'
+    StageTimes* stageTimes = nullptr; // When set, simulate() times every stage into it
 
 public:
     // Pipeline stages
-    InstructionFetch* ifStage = nullptr;
-    InstructionDecode* idStage = nullptr;
-    Execute* exStage = nullptr;
-    MemoryAccess* memStage = nullptr;
-    WriteBack* wbStage = nullptr;
-    map<uint32_t, vector<string>> pipelineMatrix;
-    // Constructor takes a filename to load instructions from
+    InstructionFetch ifStage{this};
+    InstructionDecode idStage{this};
+    Execute exStage{this};
+    MemoryAccess memStage{this};
+    WriteBack wbStage{this};
+    PipelineTrace pipelineTrace; // Stages occupied by each instruction, per cycle
+    unique_ptr<PipelineStream> pipelineStream; // Spills the trace during long runs, if set
+    unique_ptr<InstructionTraceWriter> instructionTrace; // Binary per-instruction trace, if set
+    uint64_t fetchSeq = 0; // Dynamic number of the instruction IF fetches next
+    // Record in the diagram (and the instruction trace) that `stage` touched
+    // the instruction at pc, dynamic number seq, during cycle
+    void markStage(uint32_t pc, uint64_t seq, int cycle, uint8_t stage) {
+        pipelineTrace.mark(instructionRow(pc), cycle, stage);
+        if (instructionTrace) instructionTrace->mark(seq, pc, cycle, stage);
+    }
+    // Smallest dynamic number still held by a pipeline register or by IF
+    uint64_t oldestInFlight() const;
+    // ID holds the instruction at pc, dynamic number seq, for a hazard
+    void countStall(HazardType type, uint32_t pc, uint64_t seq) {
+        stats.countStall(type, instructionRow(pc));
+        if (instructionTrace) instructionTrace->stall(seq, static_cast<uint8_t>(type));
+    }
+    // Constructor takes a filename to load instructions from; exits on errors
     Processor(const string& filename, const int cyclecount);
-    ~Processor();
-    bool hazard_in_id = false;
+    // Run a program that has already been loaded
+    Processor(shared_ptr<const DecodedProgram> program, const int cyclecount);
+    Processor(const Processor&) = delete;
+    Processor& operator=(const Processor&) = delete;
+    bool haltRequested = false; // ecall/ebreak decoded: stop fetching and drain
+    bool drainRequested = false; // Stop fetching until the instructions in flight have retired
+    bool fetchFault = false;    // pc was not word aligned; the run stops without a diagram
+    PipelineStats stats; // Counters of the current run
+
+    // Optional L1 data cache timing model; a miss holds MEM (and the stages
+    // behind it) for the miss cycles
+    unique_ptr<Cache> dataCache;
+    bool memBusy = false;          // MEM waits for the data cache this cycle: EX, ID and IF hold
+    bool memAccessStarted = false; // The access in EX/MEM has looked up the cache
+    uint32_t memWaitCycles = 0;    // Cycles the access in EX/MEM still waits
+    void setDataCache(const CacheConfig& config) { dataCache.reset(new Cache(config)); }
+
+    // Optional L1 instruction cache timing model; a miss holds IF for the
+    // miss cycles while ID receives no-ops
+    unique_ptr<Cache> instructionCache;
+    bool fetchAccessStarted = false; // The fetch at pc has looked up the cache
+    uint32_t fetchWaitCycles = 0;    // Cycles the fetch at pc still waits
+    void setInstructionCache(const CacheConfig& config) { instructionCache.reset(new Cache(config)); }
+
+    // Optional branch predictor: IF fetches from its predicted address and ID
+    // redirects fetch only when the resolved branch or jump disagrees. Without
+    // one, every taken branch or jump redirects.
+    unique_ptr<BranchPredictor> branchPredictor;
+    void setBranchPredictor(const PredictorConfig& config) { branchPredictor = BranchPredictor::create(config); }
+    // Called by ID for the branch or jump at pc in IF/ID
+    void resolveControlTransfer(uint32_t pc, bool conditional, bool taken, uint32_t target);
+
+    // Optional multi-cycle multiplier/divider (see MulDivUnit); without one,
+    // mul, div and rem complete in EX in one cycle like an add
+    unique_ptr<MulDivUnit> mulDivUnit;
+    void setMulDivUnit(const MulDivConfig& config) { mulDivUnit.reset(new MulDivUnit(config)); }
+    // Scoreboard check of the instruction in IF/ID, which would enter EX in
+    // the next cycle. issuingInEX: the instruction in ID/EX has not been
+    // through EX yet this cycle (forwarding: ID looks before EX runs).
+    HazardType checkMulDivHazard(bool issuingInEX);
+    // End of WB: write the results of the multiplier/divider ready in cycle
+    void completeMulDiv(int cycle);
+
+    // Optional out-of-order core (see OutOfOrderCore) that simulates every
+    // cycle in place of the pipeline; the forwarding policy, depth and issue
+    // width are then unused
+    unique_ptr<OutOfOrderCore> outOfOrderCore;
+    void setOutOfOrder(const OutOfOrderConfig& config) { outOfOrderCore.reset(new OutOfOrderCore(*this, config)); }
+
+    // Split fetch, execute and memory access into several stages; takes
+    // effect at the next reset()
+    void setPipelineDepth(const PipelineDepth& stages) { depth = stages; }
+    const PipelineDepth& getPipelineDepth() const { return depth; }
+    // Move the instructions of a split stage on by one stage: the latch after
+    // it takes those leaving the last stage, and the register returned (the
+    // latch itself when the stage is not split) is the output of the first,
+    // for the stage to write. kSplit false: no stage is split, the latch.
+    template <bool kSplit = true>
+    IF_ID_Register& advanceFetch() { return kSplit ? advance(slot->fetchLine, slot->if_id) : slot->if_id; }
+    template <bool kSplit = true>
+    EX_MEM_Register& advanceExecute() { return kSplit ? advance(slot->executeLine, slot->ex_mem) : slot->ex_mem; }
+    template <bool kSplit = true>
+    MEM_WB_Register& advanceMemory() { return kSplit ? advance(slot->memoryLine, slot->mem_wb) : slot->mem_wb; }
+    vector<IF_ID_Register>& getFetchLine() { return slot->fetchLine; }
+    vector<EX_MEM_Register>& getExecuteLine() { return slot->executeLine; }
+    vector<MEM_WB_Register>& getMemoryLine() { return slot->memoryLine; }
+
+    // Wide in-order issue: IF fetches up to `width` consecutive instructions
+    // a cycle, one per slot, and ID issues them oldest first until one has
+    // to wait; the rest of the bundle waits with it, in its slots, and IF
+    // fetches the next bundle once all of it has issued. Takes effect at the
+    // next reset(); 1 (the default) is the scalar pipeline.
+    void setIssueWidth(uint32_t width) { issueWidth = width; }
+    uint32_t getIssueWidth() const { return issueWidth; }
+    // Make the stages work on the registers of slot `index`
+    void selectSlot(uint32_t index) { slot = &slots[index]; }
+    // Some instruction fetched into IF/ID has yet to issue (wide pipeline)
+    bool bundleHeld() const;
+    // Hazards are found by where the instructions ahead are (checkDeepHazards,
+    // checkDeepInterlock) rather than by the five-stage latch comparisons:
+    // split execute or memory stages, or more than one slot
+    bool generalHazards() const { return depth.deepBackend() || issueWidth > 1; }
+    // Split execute or memory stages (deepBackend): hazards by the distance
+    // between the stage producing a result and the one using it, with
+    // forwarding from every stage past the producing one
+    HazardType checkDeepHazards();
+    // ... and without forwarding, the interlock of ID
+    HazardType checkDeepInterlock(uint32_t rs1, uint32_t rs2);
+    // Wide pipeline: what keeps the instruction in the selected slot's IF/ID
+    // from issuing with the older ones of its bundle still in IF/ID: reading
+    // a register one of them writes, or a pairing rule (one load/store per
+    // group; a branch, jump, ecall/ebreak or multi-cycle mul/div ends it)
+    HazardType checkBundleHazards() const;
+    // Value of reg for the instruction with dynamic number seq: that of the
+    // youngest older instruction in flight past ID that writes it, or the
+    // register file's
+    int32_t bypassValue(uint32_t reg, uint64_t seq) const;
+
+    // Return address given to the program in halt mode; returning to it ends the run
+    static constexpr uint32_t kReturnSentinel = 0xFFFFFFF0;
+    static constexpr int kDefaultMaxCycles = 1000000;
+    // Initial sp of an ELF executable: the stack grows down from here
+    static constexpr uint32_t kStackTop = 0x7FFFFFF0;
     uint32_t getnoofinstructions() { return instructionLines.size(); }
-    void loadInstructions(const string& filename, const int cyclecount);
-    void run(int cycles, const string& inputFile);
+    const shared_ptr<const DecodedProgram>& getProgram() const { return program; }
+    // Simulate `cycles` cycles, or in untilHalt mode until the program has
+    // finished with at most `cycles` cycles; prints the diagram and returns
+    // the number of cycles simulated
+    int run(int cycles, const string& inputFile, bool untilHalt = false);
+    // Same as run() without printing the diagram; the run also stops once
+    // stats.retired reaches retireLimit
+    int simulate(int cycles, bool untilHalt = false, uint64_t retireLimit = UINT64_MAX);
+    // Same as simulate() for one slice of a longer run: no warning when the
+    // program has not finished within `cycles`, and nothing is simulated
+    // once it has
+    int step(int cycles, bool untilHalt = false, uint64_t retireLimit = UINT64_MAX);
+    // One cycle of the pipeline under a forwarding policy; kTimeStages adds
+    // the time spent in every stage to *stageTimes
+    template <typename Policy, bool kTimeStages>
     void cycle(const int i);
+    // cycle() of a wide pipeline: the stages run once per slot
+    template <typename Policy, bool kTimeStages>
+    void wideCycle(const int i);
+    template <typename Policy, bool kTimeStages>
+    int runPipeline(int cycles, bool untilHalt, uint64_t retireLimit);
+    // step() with the policies of one shape (see Pipeline.hpp)
+    template <bool kGeneral>
+    int stepShape(int cycles, bool untilHalt, uint64_t retireLimit);
+
+    // Forwarding policy used by run()
+    bool isForwardingEnabled() const { return forwardingEnabled; }
+    void setForwardingEnabled(bool enabled) { forwardingEnabled = enabled; }
+    // Profile the stages of later runs into times (nullptr stops profiling).
+    // Untimed runs use a separate instantiation and pay nothing for this.
+    void setStageTimes(StageTimes* times) { stageTimes = times; }
+    // Clear registers, pc and the pipeline registers before a run; pc, sp
+    // and gp then take the program's initial values, and in halt mode ra is
+    // set to kReturnSentinel. tp holds the hart id.
+    void reset(bool untilHalt);
+
+    // Multi-hart runs (see HartGroup): this core is hart `id` of `count`.
+    // The program finds its id in tp, and the sp of an ELF executable is
+    // kHartStackSize lower for every hart. Diagrams get a "_hart<id>" suffix.
+    void setHart(uint32_t id, uint32_t count) { hartId = id; hartCount = count; }
+    uint32_t getHartId() const { return hartId; }
+    static constexpr uint32_t kHartStackSize = 1u << 20;
+    // Use the data memory of other from now on (see DataMemory::share)
+    void shareMemory(Processor& other) { memory.share(other.memory); }
+    int getCycle() const { return currentCycle; }
+
+    // Write every dynamic instruction of the runs that follow to filename
+    // (see Trace.hpp), until finishInstructionTrace(); false if it cannot be
+    // created
+    bool startInstructionTrace(const string& filename);
+    bool finishInstructionTrace();
+
+    // Checkpoint of everything a run depends on: registers, memory, pc, the
+    // pipeline registers, the cycle index and the results the multiplier/
+    // divider has yet to write, plus the contents of the caches and the
+    // predictor. It is restored into a Processor loaded with the same program,
+    // in either forwarding mode but with the same pipeline depth and issue
+    // width; a cache, predictor or multiplier/divider configured differently
+    // than when the checkpoint was taken starts cold. The counters and the diagram of the
+    // restored run start at the checkpoint. Errors are reported on cerr.
+    void saveCheckpoint(ostream& out) const;
+    bool saveCheckpoint(const string& filename) const;
+    bool restoreCheckpoint(istream& in);
+    bool restoreCheckpoint(const string& filename);
+
+    // Functional execution: one whole instruction per step using the same
+    // decoded records and ALU as the pipeline, without pipeline registers or
+    // trace. Returns false (executing nothing) once the program has finished.
+    // With functionalWarming set, every fetch, load/store and control
+    // transfer also updates the caches and the branch predictor.
+    bool stepFunctional();
+    bool functionalWarming = false;
+    // Execute up to maxInstructions functionally; returns the number executed
+    uint64_t runFunctional(uint64_t maxInstructions);
+    // Sampled simulation (see SamplingConfig) until the program finishes or
+    // about maxInstructions have executed; no diagram is recorded and stats
+    // only cover the detailed stretches
+    SamplingResult runSampled(const SamplingConfig& config, uint64_t maxInstructions);
+    // The measured windows and the whole-run estimates as a JSON object
+    void writeSampledStats(ostream& out, const SamplingConfig& config, const SamplingResult& result) const;
+    void printRegisters(ostream& out) const;
+    // True once fetch has stopped (ecall/ebreak, drainRequested, or pc left
+    // the program) and every pipeline register is empty
+    bool isHalted() const;
+    // No instruction in any pipeline register: pc is the next instruction to execute
+    bool isPipelineEmpty() const;
 
     uint32_t getPC() const { return pc; }
     void setPC(uint32_t newPC) { pc = newPC; }
 
     int32_t getRegister(int index) const;
     void setRegister(int index, int32_t value);
-    uint32_t getMemory(uint32_t address) const;
-    void setMemory(uint32_t address, uint32_t value);
-    uint32_t getInstruction(uint32_t address) const;
+    uint32_t getMemory(uint32_t address) const { return memory.readWord(address); }
+    void setMemory(uint32_t address, uint32_t value) { memory.writeWord(address, value); }
+    // Width- and sign-aware accesses selected by the funct3 of a load/store
+    int32_t loadData(uint32_t address, uint32_t funct3) const {
+        switch (funct3) {
+        case 0x0: return memory.read<int8_t>(address);   // LB
+        case 0x1: return memory.read<int16_t>(address);  // LH
+        case 0x4: return memory.read<uint8_t>(address);  // LBU
+        case 0x5: return memory.read<uint16_t>(address); // LHU
+        default: return memory.read<int32_t>(address);   // LW
+        }
+    }
+    void storeData(uint32_t address, uint32_t funct3, uint32_t value) {
+        switch (funct3) {
+        case 0x0: memory.write<uint8_t>(address, value); break;  // SB
+        case 0x1: memory.write<uint16_t>(address, value); break; // SH
+        default: memory.write<uint32_t>(address, value); break;  // SW
+        }
+    }
+    uint32_t getInstruction(uint32_t address) const { return getDecoded(address).instruction; }
+    // Row of the diagram (index in the program) of the instruction at
+    // address; getnoofinstructions() or more outside the program
+    uint32_t instructionRow(uint32_t address) const { return (address - textBase) / 4; }
+    const DecodedInstruction& getDecoded(uint32_t address) const {
+        uint32_t index = instructionRow(address);
+        if (address % 4 != 0 || index >= instructionMemory.size()) {
+            return kNoInstruction; // Non-existent instruction
+        }
+        return instructionMemory[index];
+    }
 
     // Get/set methods for pipeline registers
-    IF_ID_Register& getIF_ID() { return if_id; }
-    ID_EX_Register& getID_EX() { return id_ex; }
-    EX_MEM_Register& getEX_MEM() { return ex_mem; }
-    MEM_WB_Register& getMEM_WB() { return mem_wb; }
+    IF_ID_Register& getIF_ID() { return slot->if_id; }
+    ID_EX_Register& getID_EX() { return slot->id_ex; }
+    EX_MEM_Register& getEX_MEM() { return slot->ex_mem; }
+    MEM_WB_Register& getMEM_WB() { return slot->mem_wb; }
+    // Found by checkForHazards() this cycle for the selected slot
+    HazardType& hazardInID() { return slot->hazardInID; }
     ForwardingSignals& getForwarding() { return forwarding; }
 
     // Update forwarding signals based on current pipeline state
     void updateForwardingSignals();
 
-    // Check for hazards that require stalling
-    bool checkForHazards();
+    // Check for hazards that require stalling (forwarding processor)
+    HazardType checkForHazards();
 
     // Methods for handling branches
     void setBranch(bool taken, uint32_t target);
@@ -258,6 +835,17 @@ public:
     uint32_t getBranchTarget() const { return branchTarget; }
 
     void print_pipeline(int cycles, bool forwardingEnabled, const string& inputFile);
+    // Cycle header and one row per instruction, for the cycles from the
+    // start of the run (or the restored checkpoint) up to `cycles`
+    void writePipeline(ostream& out, int cycles);
+    // Render the diagram while simulating, spilling every `window` cycles
+    // (0 keeps the whole trace in memory until it is written)
+    void setStreamWindow(int window);
+    // File print_pipeline writes for inputFile, inside the output directory
+    string outputFileName(const string& inputFile, bool forwardingEnabled) const;
+    void setOutputDirectory(const string& directory) { outputDirectory = directory; }
+    // stats as a JSON object
+    void writeStats(ostream& out) const;
 };
 
 #endif // PROCESSOR_HPP
\ No newline at end of file
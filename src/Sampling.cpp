@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include "Processor.hpp"
+
+bool SamplingConfig::parse(const string& text, SamplingConfig& config) {
+    vector<uint64_t> fields;
+    istringstream in(text);
+    string field;
+    try {
+        while (getline(in, field, ':')) {
+            if (field.empty() || field[0] == '-') return false;
+            fields.push_back(stoull(field));
+        }
+    } catch (const exception&) {
+        return false;
+    }
+    if (fields.size() < 2 || fields.size() > 4) return false;
+    config.period = fields[0];
+    config.window = fields[1];
+    if (fields.size() > 2) config.warming = fields[2];
+    if (fields.size() > 3) config.detailedWarmup = fields[3];
+    return config.window > 0 && config.window + config.warming + config.detailedWarmup <= config.period;
+}
+
+string SamplingConfig::describe() const {
+    ostringstream out;
+    out << period << ":" << window << ":" << warming << ":" << detailedWarmup;
+    return out.str();
+}
+
+double SamplingResult::meanCPI() const {
+    double sum = 0;
+    for (double cpi : windowCPI) sum += cpi;
+    return windowCPI.empty() ? 0.0 : sum / windowCPI.size();
+}
+
+double SamplingResult::confidenceCPI() const {
+    size_t n = windowCPI.size();
+    if (n < 2) return 0.0;
+    double mean = meanCPI();
+    double squares = 0;
+    for (double cpi : windowCPI) squares += (cpi - mean) * (cpi - mean);
+    return 1.96 * sqrt(squares / (n - 1) / n);
+}
+
+SamplingResult Processor::runSampled(const SamplingConfig& config, uint64_t maxInstructions) {
+    SamplingResult result;
+    result.stalls.assign(PipelineStats::kHazardTypes, 0);
+    // Only the counters are kept; the trace is dropped before every sample
+    setStreamWindow(0);
+    // A detailed stretch ends long before this unless the program loops without retiring
+    const int cycleCap = kDefaultMaxCycles;
+
+    uint64_t fastForward = config.period - config.window - config.warming - config.detailedWarmup;
+    uint64_t sampleStart = 0; // Instruction the current period starts at
+    while (!isHalted() && !fetchFault && result.instructions < maxInstructions) {
+        // Functional fast-forward to the warming point, then warming
+        uint64_t warmStart = min(sampleStart + fastForward, maxInstructions);
+        uint64_t warmEnd = min(sampleStart + fastForward + config.warming, maxInstructions);
+        if (result.instructions < warmStart) {
+            result.instructions += runFunctional(warmStart - result.instructions);
+        }
+        if (result.instructions < warmEnd) {
+            functionalWarming = true;
+            result.instructions += runFunctional(warmEnd - result.instructions);
+            functionalWarming = false;
+        }
+        if (isHalted() || result.instructions >= maxInstructions) break;
+
+        // Fill the pipeline, then measure one window with the full model
+        pipelineTrace.clear(currentCycle);
+        uint64_t retiredStart = stats.retired;
+        simulate(cycleCap, true, retiredStart + config.detailedWarmup);
+        // The scalar counters only: stallsByRow is as long as the program
+        PipelineStats before;
+        before.cycles = stats.cycles;
+        before.retired = stats.retired;
+        before.flushes = stats.flushes;
+        before.memoryStalls = stats.memoryStalls;
+        before.fetchStalls = stats.fetchStalls;
+        before.mispredictions = stats.mispredictions;
+        copy(begin(stats.stalls), end(stats.stalls), before.stalls);
+        simulate(cycleCap, true, before.retired + config.window);
+        // A wide pipeline can retire a few instructions past the window
+        uint64_t measured = stats.retired - before.retired;
+        if (measured >= config.window) {
+            // A window cut short by the end of the program would count its drain
+            uint64_t cycles = stats.cycles - before.cycles;
+            result.windowCPI.push_back(double(cycles) / measured);
+            result.measuredCycles += cycles;
+            result.measuredInstructions += measured;
+            result.flushes += stats.flushes - before.flushes;
+            result.memoryStalls += stats.memoryStalls - before.memoryStalls;
+            result.fetchStalls += stats.fetchStalls - before.fetchStalls;
+            result.mispredictions += stats.mispredictions - before.mispredictions;
+            for (int type = 0; type < PipelineStats::kHazardTypes; type++) {
+                result.stalls[type] += stats.stalls[type] - before.stalls[type];
+            }
+        }
+
+        // Let the instructions in flight retire so that functional execution
+        // resumes at pc
+        drainRequested = true;
+        simulate(cycleCap, true);
+        drainRequested = false;
+        result.instructions += stats.retired - retiredStart;
+        result.detailedInstructions += stats.retired - retiredStart;
+        sampleStart += config.period;
+    }
+    return result;
+}
+
+void Processor::writeSampledStats(ostream& out, const SamplingConfig& config, const SamplingResult& result) const {
+    // Rates per measured instruction, scaled to the whole run
+    double scale = result.measuredInstructions ? double(result.instructions) / result.measuredInstructions : 0.0;
+    double cpi = result.meanCPI();
+    double interval = result.confidenceCPI();
+    out << "{\n";
+    out << "  \"forwarding\": " << (forwardingEnabled ? "true" : "false") << ",\n";
+    out << "  \"sampling\": \"" << config.describe() << "\",\n";
+    out << "  \"instructions\": " << result.instructions << ",\n";
+    out << "  \"detailed_instructions\": " << result.detailedInstructions << ",\n";
+    out << "  \"windows\": " << result.windowCPI.size() << ",\n";
+    out << "  \"measured_cycles\": " << result.measuredCycles << ",\n";
+    out << "  \"measured_instructions\": " << result.measuredInstructions << ",\n";
+    out << "  \"cpi\": " << cpi << ",\n";
+    out << "  \"cpi_ci95\": [" << cpi - interval << ", " << cpi + interval << "],\n";
+    out << "  \"cpi_relative_error\": " << (cpi > 0 ? interval / cpi : 0.0) << ",\n";
+    out << "  \"estimated_cycles\": " << llround(cpi * result.instructions) << ",\n";
+    out << "  \"estimated_cycles_ci95\": [" << llround((cpi - interval) * result.instructions) << ", "
+        << llround((cpi + interval) * result.instructions) << "],\n";
+    out << "  \"estimated_flushes\": " << llround(result.flushes * scale) << ",\n";
+    out << "  \"estimated_mispredictions\": " << llround(result.mispredictions * scale) << ",\n";
+    if (dataCache) {
+        out << "  \"estimated_dcache_stalls\": " << llround(result.memoryStalls * scale) << ",\n";
+    }
+    if (instructionCache) {
+        out << "  \"estimated_icache_stalls\": " << llround(result.fetchStalls * scale) << ",\n";
+    }
+    uint64_t totalStalls = 0;
+    for (uint64_t count : result.stalls) totalStalls += count;
+    out << "  \"estimated_stalls\": {\"total\": " << llround(totalStalls * scale);
+    for (int type = 1; type < PipelineStats::kHazardTypes; type++) {
+        out << ", \"" << hazardName(static_cast<HazardType>(type)) << "\": " << llround(result.stalls[type] * scale);
+    }
+    out << "}\n";
+    out << "}" << endl;
+}
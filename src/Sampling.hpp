@@ -0,0 +1,46 @@
+#ifndef SAMPLING_HPP
+#define SAMPLING_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Systematic sampling of a long run, e.g. "100000:1000:10000:50"
+// (period:window[:warming[:detailed warm-up]], all in instructions). Every
+// period starts with functional fast-forward; the caches and the branch
+// predictor are then warmed functionally, the pipeline is filled by a short
+// detailed warm-up, and the window that follows is measured cycle by cycle.
+struct SamplingConfig {
+    uint64_t period = 100000;
+    uint64_t window = 1000;
+    uint64_t warming = 10000;      // Functional steps that update caches and predictor
+    uint64_t detailedWarmup = 50;  // Detailed instructions retired before measuring
+
+    // Parse the string form; returns false on malformed values or when the
+    // parts of a sample do not fit in the period
+    static bool parse(const string& text, SamplingConfig& config);
+    string describe() const;
+};
+
+// Counters of the measured windows and their extrapolation to the whole run
+struct SamplingResult {
+    uint64_t instructions = 0;         // Executed in total, functionally and in detail
+    uint64_t detailedInstructions = 0; // Retired by the pipeline (warm-up, windows and drain)
+    vector<double> windowCPI;          // CPI of each measured window
+    uint64_t measuredCycles = 0;
+    uint64_t measuredInstructions = 0;
+    uint64_t flushes = 0;              // Summed over the measured windows, like the rest
+    uint64_t memoryStalls = 0;
+    uint64_t fetchStalls = 0;
+    uint64_t mispredictions = 0;
+    vector<uint64_t> stalls;           // By HazardType
+
+    double meanCPI() const;
+    // Half-width of the 95% confidence interval of meanCPI() (normal
+    // approximation over the windows; 0 with fewer than two)
+    double confidenceCPI() const;
+};
+
+#endif // SAMPLING_HPP
@@ -0,0 +1,349 @@
+#include "Trace.hpp"
+#include "Processor.hpp"
+
+namespace {
+const uint32_t kTraceMagic = 0x52545652; // "RVTR"
+const uint32_t kTraceVersion = 2; // 2 added split stages
+const uint32_t kMaxLabel = 4096;  // Longest row label a reader accepts, like a checkpoint string
+
+// PipelineTrace bit of every InstructionRecord::Stage
+const uint8_t kStageBits[InstructionRecord::kStages] = {
+    PipelineTrace::IF, PipelineTrace::ID, PipelineTrace::EX, PipelineTrace::MEM, PipelineTrace::WB
+};
+
+const uint32_t kSquashedFlag = 1 << 5;
+const uint32_t kStalledFlag = 1 << 6;
+const uint32_t kSplitFlag = 1 << 7;
+
+// Number of sub-stages entered within the first `cycles` cells of a stage
+uint32_t subStagesEntered(uint32_t mask, uint32_t cycles) {
+    if (cycles < 32) mask &= (1u << cycles) - 1;
+    uint32_t count = 0;
+    for (; mask; mask &= mask - 1) count++;
+    return count;
+}
+
+void putU32(vector<uint8_t>& out, uint32_t value) {
+    for (int byte = 0; byte < 4; byte++) {
+        out.push_back(value >> (8 * byte));
+    }
+}
+
+uint32_t getU32(const uint8_t* in) {
+    return in[0] | (in[1] << 8) | (in[2] << 16) | (static_cast<uint32_t>(in[3]) << 24);
+}
+
+void putVarint(vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+void putSigned(vector<uint8_t>& out, int64_t value) {
+    putVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+// Decodes one payload; every read fails once the payload is exhausted
+class PayloadReader {
+public:
+    PayloadReader(const vector<uint8_t>& payload) : next(payload.data()), end(payload.data() + payload.size()) {}
+
+    bool varint(uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64 && next < end; shift += 7) {
+            uint8_t byte = *next++;
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+    bool signedVarint(int64_t& value) {
+        uint64_t encoded;
+        if (!varint(encoded)) return false;
+        value = static_cast<int64_t>(encoded >> 1) ^ -static_cast<int64_t>(encoded & 1);
+        return true;
+    }
+
+private:
+    const uint8_t* next;
+    const uint8_t* end;
+};
+} // namespace
+
+uint8_t InstructionRecord::stageBits(int stage, uint32_t cycle) const {
+    uint8_t bits = kStageBits[stage] | PipelineTrace::subStage(subStagesEntered(subStageMask[stage], cycle + 1));
+    if (stage == ID && squashed && (cycle >= 32 || (clearMask >> cycle) & 1)) {
+        bits |= PipelineTrace::CLEAR;
+    }
+    return bits;
+}
+
+bool InstructionTraceWriter::open(const string& filename, const TraceHeader& header) {
+    out.open(filename, ios::binary);
+    if (!out) return false;
+    vector<uint8_t> bytes;
+    putU32(bytes, kTraceMagic);
+    putU32(bytes, kTraceVersion);
+    bytes.push_back(header.forwarding);
+    putU32(bytes, header.textBase);
+    putU32(bytes, header.firstCycle);
+    putU32(bytes, header.labels.size());
+    for (const auto& label : header.labels) {
+        putU32(bytes, label.first);
+        putU32(bytes, label.second.size());
+        bytes.insert(bytes.end(), label.second.begin(), label.second.end());
+    }
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    return out.good();
+}
+
+void InstructionTraceWriter::mark(uint64_t seq, uint32_t pc, int cycle, uint8_t stage) {
+    if (seq < baseSeq) return; // Already written
+    while (inFlight.size() <= seq - baseSeq) {
+        inFlight.emplace_back();
+    }
+    InstructionRecord& record = inFlight[seq - baseSeq];
+    record.pc = pc;
+    if (stage == PipelineTrace::CLEAR) {
+        record.squashed = true;
+        uint32_t offset = cycle - record.first[InstructionRecord::ID];
+        if (offset < 32) record.clearMask |= 1u << offset;
+        return;
+    }
+    uint32_t subStage = (stage & PipelineTrace::kSubStageMask) >> PipelineTrace::kSubStageShift;
+    stage &= ~PipelineTrace::kSubStageMask;
+    for (int s = 0; s < InstructionRecord::kStages; s++) {
+        if (kStageBits[s] != stage) continue;
+        if (record.first[s] < 0) {
+            record.first[s] = cycle;
+        }
+        // A stage marks an instruction once per cycle, in consecutive cycles
+        uint32_t offset = cycle - record.first[s];
+        record.cycles[s] = offset + 1;
+        if (subStage > subStagesEntered(record.subStageMask[s], 32) && offset < 32) {
+            record.subStageMask[s] |= 1u << offset;
+        }
+    }
+}
+
+void InstructionTraceWriter::stall(uint64_t seq, uint8_t cause) {
+    if (seq < baseSeq || seq - baseSeq >= inFlight.size()) return;
+    InstructionRecord& record = inFlight[seq - baseSeq];
+    if (record.stallCycles++ == 0) {
+        record.stallCause = cause;
+    }
+}
+
+void InstructionTraceWriter::retireBefore(uint64_t seq) {
+    while (baseSeq < seq && !inFlight.empty()) {
+        if (!inFlight.front().empty()) {
+            writeRecord(inFlight.front());
+        }
+        inFlight.pop_front();
+        baseSeq++;
+    }
+    if (inFlight.empty() && baseSeq < seq) {
+        baseSeq = seq;
+    }
+}
+
+bool InstructionTraceWriter::finish(int cycles) {
+    retireBefore(UINT64_MAX);
+    writeBlock();
+    vector<uint8_t> end;
+    putU32(end, 0);
+    putU32(end, 0);
+    putU32(end, cycles);
+    putU32(end, cycles);
+    out.write(reinterpret_cast<const char*>(end.data()), end.size());
+    out.close();
+    return !out.fail();
+}
+
+void InstructionTraceWriter::writeRecord(const InstructionRecord& record) {
+    uint32_t flags = 0;
+    int firstStage = -1;
+    int32_t recordLast = 0;
+    for (int s = 0; s < InstructionRecord::kStages; s++) {
+        if (record.first[s] < 0) continue;
+        flags |= 1u << s;
+        if (firstStage < 0) firstStage = s;
+        recordLast = max<int32_t>(recordLast, record.first[s] + record.cycles[s] - 1);
+        if (record.subStageMask[s]) flags |= kSplitFlag;
+    }
+    if (record.squashed) flags |= kSquashedFlag;
+    if (record.stallCycles) flags |= kStalledFlag;
+
+    int32_t recordFirst = record.first[firstStage];
+    if (blockRecords == 0) {
+        previousPC = 0;
+        previousCycle = 0;
+        blockFirst = recordFirst;
+        blockLast = recordLast;
+    }
+    putVarint(payload, flags);
+    putSigned(payload, static_cast<int32_t>(record.pc - previousPC));
+    putSigned(payload, static_cast<int64_t>(recordFirst) - previousCycle);
+    putVarint(payload, record.cycles[firstStage]);
+    int64_t stageEnd = static_cast<int64_t>(recordFirst) + record.cycles[firstStage];
+    for (int s = firstStage + 1; s < InstructionRecord::kStages; s++) {
+        if (record.first[s] < 0) continue;
+        putSigned(payload, record.first[s] - stageEnd);
+        putVarint(payload, record.cycles[s]);
+        stageEnd = static_cast<int64_t>(record.first[s]) + record.cycles[s];
+    }
+    if (record.stallCycles) {
+        putVarint(payload, record.stallCause);
+        putVarint(payload, record.stallCycles);
+    }
+    if (record.squashed) {
+        putVarint(payload, record.clearMask);
+    }
+    if (flags & kSplitFlag) {
+        for (int s = firstStage; s < InstructionRecord::kStages; s++) {
+            if (record.first[s] >= 0) putVarint(payload, record.subStageMask[s]);
+        }
+    }
+    previousPC = record.pc;
+    previousCycle = recordFirst;
+    blockFirst = min(blockFirst, recordFirst);
+    blockLast = max(blockLast, recordLast);
+    if (++blockRecords == kBlockRecords) {
+        writeBlock();
+    }
+}
+
+void InstructionTraceWriter::writeBlock() {
+    if (blockRecords == 0) return;
+    vector<uint8_t> header;
+    putU32(header, payload.size());
+    putU32(header, blockRecords);
+    putU32(header, blockFirst);
+    putU32(header, blockLast);
+    out.write(reinterpret_cast<const char*>(header.data()), header.size());
+    out.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+    payload.clear();
+    blockRecords = 0;
+}
+
+bool InstructionTraceReader::open(const string& filename, string& error) {
+    in.open(filename, ios::binary);
+    if (!in) {
+        error = "could not open " + filename;
+        return false;
+    }
+    in.seekg(0, ios::end);
+    fileSize = static_cast<uint64_t>(in.tellg());
+    in.seekg(0, ios::beg);
+    uint8_t fixed[21];
+    if (!in.read(reinterpret_cast<char*>(fixed), sizeof(fixed)) || getU32(fixed) != kTraceMagic) {
+        error = filename + " is not an instruction trace";
+        return false;
+    }
+    // Version 1 traces are version 2 traces without split stages
+    if (getU32(fixed + 4) == 0 || getU32(fixed + 4) > kTraceVersion) {
+        error = filename + " has an unsupported trace version";
+        return false;
+    }
+    header.forwarding = fixed[8] != 0;
+    header.textBase = getU32(fixed + 9);
+    header.firstCycle = static_cast<int32_t>(getU32(fixed + 13));
+    uint32_t rows = getU32(fixed + 17);
+    for (uint32_t row = 0; row < rows; row++) {
+        uint8_t label[8];
+        if (!in.read(reinterpret_cast<char*>(label), sizeof(label))) break;
+        // A label is one line of a listing or a disassembly: a longer one is corrupt
+        uint32_t length = getU32(label + 4);
+        if (length > kMaxLabel || length > remaining()) break;
+        string text(length, '\0');
+        if (!in.read(&text[0], text.size())) break;
+        header.labels.emplace_back(getU32(label), move(text));
+    }
+    if (header.labels.size() != rows) {
+        error = filename + " is truncated";
+        return false;
+    }
+    return true;
+}
+
+uint64_t InstructionTraceReader::remaining() {
+    uint64_t position = static_cast<uint64_t>(in.tellg());
+    return position < fileSize ? fileSize - position : 0;
+}
+
+bool InstructionTraceReader::nextBlock(uint32_t& records, int32_t& firstCycle, int32_t& lastCycle) {
+    if (ended) return false;
+    uint8_t fixed[16];
+    if (!in.read(reinterpret_cast<char*>(fixed), sizeof(fixed))) return false;
+    payloadBytes = getU32(fixed);
+    payloadRecords = records = getU32(fixed + 4);
+    firstCycle = static_cast<int32_t>(getU32(fixed + 8));
+    lastCycle = static_cast<int32_t>(getU32(fixed + 12));
+    if (payloadBytes == 0 && payloadRecords == 0) {
+        ended = true;
+        endCycle = firstCycle;
+        return false;
+    }
+    // A block cannot be longer than the rest of the file
+    return payloadBytes <= remaining();
+}
+
+bool InstructionTraceReader::skipRecords() {
+    in.seekg(payloadBytes, ios::cur);
+    return in.good();
+}
+
+bool InstructionTraceReader::readRecords(vector<InstructionRecord>& records) {
+    vector<uint8_t> payload(payloadBytes);
+    if (!in.read(reinterpret_cast<char*>(payload.data()), payload.size())) return false;
+    PayloadReader reader(payload);
+    records.clear();
+    records.reserve(payloadRecords);
+    uint32_t pc = 0;
+    int64_t cycle = 0;
+    for (uint32_t n = 0; n < payloadRecords; n++) {
+        InstructionRecord record;
+        uint64_t flags, count, value;
+        int64_t delta;
+        if (!reader.varint(flags) || !reader.signedVarint(delta)) return false;
+        record.pc = pc += static_cast<uint32_t>(delta);
+        if (!reader.signedVarint(delta)) return false;
+        cycle += delta;
+        int64_t stageEnd = cycle;
+        bool firstStage = true;
+        for (int s = 0; s < InstructionRecord::kStages; s++) {
+            if (!(flags & (1u << s))) continue;
+            if (!firstStage) {
+                if (!reader.signedVarint(delta)) return false;
+                stageEnd += delta;
+            }
+            if (!reader.varint(count)) return false;
+            record.first[s] = static_cast<int32_t>(stageEnd);
+            record.cycles[s] = static_cast<uint32_t>(count);
+            stageEnd += count;
+            firstStage = false;
+        }
+        if (firstStage) return false; // A record goes through at least one stage
+        if (flags & kStalledFlag) {
+            if (!reader.varint(value) || !reader.varint(count)) return false;
+            record.stallCause = static_cast<uint8_t>(value);
+            record.stallCycles = static_cast<uint32_t>(count);
+        }
+        if (flags & kSquashedFlag) {
+            if (!reader.varint(value)) return false;
+            record.squashed = true;
+            record.clearMask = static_cast<uint32_t>(value);
+        }
+        if (flags & kSplitFlag) {
+            for (int s = 0; s < InstructionRecord::kStages; s++) {
+                if (record.first[s] < 0) continue;
+                if (!reader.varint(value)) return false;
+                record.subStageMask[s] = static_cast<uint32_t>(value);
+            }
+        }
+        records.push_back(record);
+    }
+    return true;
+}
@@ -0,0 +1,129 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Binary instruction trace: one record per dynamic instruction with the
+// cycles every stage held it, written while simulating (--trace) and read
+// back by tracerender. Everything is little-endian:
+//
+//   header  u32 magic "RVTR", u32 version, u8 forwarding, u32 text base,
+//           i32 first cycle, u32 rows, then per row (static instruction)
+//           u32 pc, u32 length and the text of its diagram label
+//   block   u32 payload bytes, u32 records, i32 first and i32 last cycle
+//           any record of the block touches, then the payload
+//   end     a block header with 0 bytes and 0 records, whose two cycles
+//           are the cycle the run ended at
+//
+// A payload is a sequence of records in fetch order, each as LEB128
+// varints (s: zigzag-signed), deltas relative to the previous record of
+// the same block so that every block decodes on its own:
+//   u  bits 0-4: the instruction went through IF/ID/EX/MEM/WB,
+//      bit 5: squashed in IF/ID, bit 6: held in ID by a hazard,
+//      bit 7: went through a split stage (see PipelineDepth)
+//   s  pc delta
+//   s  first cycle of the first stage it went through, delta
+//   u  cycles in that stage
+//   s, u  for each further stage: cycles since the previous stage was left
+//         (normally 0), cycles in the stage
+//   u, u  if held by a hazard: the HazardType of the first hold, cycles held
+//   u  if squashed: bit k set when ID blanked its cell k cycles after it
+//      entered ID (cells 32 and later are always blanked)
+//   u  if split: for each stage it went through, bit k set when its cell
+//      k cycles after it entered the stage is in the next sub-stage
+struct InstructionRecord {
+    enum Stage { IF, ID, EX, MEM, WB, kStages };
+
+    uint32_t pc = 0;
+    int32_t first[kStages] = { -1, -1, -1, -1, -1 }; // First cycle in each stage, -1 if never
+    uint32_t cycles[kStages] = {};                   // Cycles the stage held it
+    bool squashed = false;    // Fetched behind a taken branch or jump and dropped in ID
+    uint32_t clearMask = 0;   // See above
+    uint8_t stallCause = 0;   // HazardType
+    uint32_t stallCycles = 0; // Cycles ID held it for a hazard
+    uint32_t subStageMask[kStages] = {}; // See above; 0 in a 5-stage pipeline
+
+    bool empty() const {
+        for (int stage = 0; stage < kStages; stage++) {
+            if (first[stage] >= 0) return false;
+        }
+        return true;
+    }
+    // PipelineTrace stage bits of the cell `cycle` cycles after it entered `stage`
+    uint8_t stageBits(int stage, uint32_t cycle) const;
+};
+
+// Header of a trace file
+struct TraceHeader {
+    bool forwarding = true;
+    uint32_t textBase = 0;
+    int32_t firstCycle = 0;
+    vector<pair<uint32_t, string>> labels; // pc and diagram label of every row
+};
+
+// Collects the stage marks of the pipeline into records and writes them in
+// blocks. Dynamic instructions are identified by the sequence number IF
+// gives them; a record is written once no pipeline register holds it any
+// more (see retireBefore).
+class InstructionTraceWriter {
+public:
+    static constexpr uint32_t kBlockRecords = 4096;
+
+    bool open(const string& filename, const TraceHeader& header);
+    // `stage` (a PipelineTrace bit) touched instruction seq at pc during cycle
+    void mark(uint64_t seq, uint32_t pc, int cycle, uint8_t stage);
+    // ID held instruction seq for a hazard this cycle
+    void stall(uint64_t seq, uint8_t cause);
+    // Write every record older than seq
+    void retireBefore(uint64_t seq);
+    // Write the rest and the end marker; false if anything failed to write
+    bool finish(int cycles);
+
+private:
+    void writeRecord(const InstructionRecord& record);
+    void writeBlock();
+
+    ofstream out;
+    deque<InstructionRecord> inFlight; // Records from baseSeq on
+    uint64_t baseSeq = 0;
+    vector<uint8_t> payload;           // Current block
+    uint32_t blockRecords = 0;
+    int32_t blockFirst = 0;
+    int32_t blockLast = 0;
+    uint32_t previousPC = 0;
+    int32_t previousCycle = 0;
+};
+
+class InstructionTraceReader {
+public:
+    bool open(const string& filename, string& error);
+    const TraceHeader& getHeader() const { return header; }
+    // Header of the next block; false at the end marker or on a truncated file
+    bool nextBlock(uint32_t& records, int32_t& firstCycle, int32_t& lastCycle);
+    bool readRecords(vector<InstructionRecord>& records);
+    bool skipRecords();
+    // Cycle the run ended at, once nextBlock() has returned false on the end marker
+    int32_t getEndCycle() const { return endCycle; }
+    bool atEnd() const { return ended; }
+
+private:
+    // Bytes between the read position and the end of the file
+    uint64_t remaining();
+
+    ifstream in;
+    uint64_t fileSize = 0;
+    TraceHeader header;
+    uint32_t payloadBytes = 0;
+    uint32_t payloadRecords = 0;
+    int32_t endCycle = 0;
+    bool ended = false;
+};
+
+#endif // TRACE_HPP
@@ -0,0 +1,156 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "Processor.hpp"
+using namespace std;
+
+// Simulates many programs, each under one or both forwarding policies, with
+// one independent Processor per run spread over a pool of worker threads.
+// Diagrams are kept in memory and written once every run has finished.
+
+namespace {
+
+struct BatchJob {
+    string inputFile;
+    shared_ptr<const DecodedProgram> program; // Shared by both policies' jobs
+    bool forwarding = true;
+    int cycles = 0;        // Cycles actually simulated
+    string outputFile;
+    string diagram;        // Rendered pipeline diagram
+};
+
+struct BatchOptions {
+    int cycles = 0;
+    bool untilHalt = false;
+    bool forward = true;
+    bool noforward = true;
+    unsigned jobs = 0;     // 0: one worker per hardware thread
+    string outputDirectory = "../outputfiles/";
+    vector<string> inputFiles;
+};
+
+void printUsage(const char* program) {
+    cerr << "Usage: " << program << " <cycle_count|halt> [options] <input_file>..." << endl;
+    cerr << "  --max-cycles N      cap for halt mode (default " << Processor::kDefaultMaxCycles << ")" << endl;
+    cerr << "  --modes M           forward, noforward or both (default both)" << endl;
+    cerr << "  --jobs N            worker threads (default: hardware threads)" << endl;
+    cerr << "  --output-dir DIR    where diagrams are written (default ../outputfiles)" << endl;
+}
+
+bool parseBatchOptions(int argc, char* argv[], BatchOptions& options) {
+    if (argc < 3) return false;
+    int maxCycles = Processor::kDefaultMaxCycles;
+    string cycles = argv[1];
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--max-cycles" && i + 1 < argc) {
+            maxCycles = atoi(argv[++i]);
+        } else if (arg == "--modes" && i + 1 < argc) {
+            string modes = argv[++i];
+            options.forward = modes == "forward" || modes == "both";
+            options.noforward = modes == "noforward" || modes == "both";
+            if (!options.forward && !options.noforward) return false;
+        } else if (arg == "--jobs" && i + 1 < argc) {
+            options.jobs = atoi(argv[++i]);
+        } else if (arg == "--output-dir" && i + 1 < argc) {
+            options.outputDirectory = argv[++i];
+            if (options.outputDirectory.back() != '/') options.outputDirectory += '/';
+        } else if (arg.compare(0, 2, "--") == 0) {
+            return false;
+        } else {
+            options.inputFiles.push_back(arg);
+        }
+    }
+    options.untilHalt = cycles == "halt";
+    options.cycles = options.untilHalt ? maxCycles : atoi(cycles.c_str());
+    return options.cycles > 0 && !options.inputFiles.empty();
+}
+
+void runJob(BatchJob& job, const BatchOptions& options) {
+    Processor processor(job.program, options.untilHalt ? 0 : options.cycles);
+    processor.setForwardingEnabled(job.forwarding);
+    processor.setOutputDirectory(options.outputDirectory);
+    processor.reset(options.untilHalt);
+    job.cycles = processor.simulate(options.cycles, options.untilHalt);
+    if (processor.fetchFault) {
+        return; // Misaligned pc: no diagram, as with a single run
+    }
+    job.outputFile = processor.outputFileName(job.inputFile, job.forwarding);
+    ostringstream diagram;
+    processor.writePipeline(diagram, job.cycles);
+    job.diagram = diagram.str();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    BatchOptions options;
+    if (!parseBatchOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // Load and decode every program once, up front: a program that fails to
+    // load is reported and skipped rather than ending the process from a worker
+    vector<BatchJob> jobs;
+    int failures = 0;
+    for (const string& inputFile : options.inputFiles) {
+        string error;
+        shared_ptr<const DecodedProgram> program = DecodedProgram::load(inputFile, error);
+        if (!program) {
+            cerr << "Error: " << error << " (skipped)" << endl;
+            failures++;
+            continue;
+        }
+        for (int mode = 0; mode < 2; mode++) {
+            bool forwarding = mode == 0;
+            if (forwarding ? !options.forward : !options.noforward) continue;
+            BatchJob job;
+            job.inputFile = inputFile;
+            job.program = program;
+            job.forwarding = forwarding;
+            jobs.push_back(job);
+        }
+    }
+
+    auto start = chrono::steady_clock::now();
+    unsigned workers = options.jobs ? options.jobs : max(1u, thread::hardware_concurrency());
+    workers = min<unsigned>(workers, jobs.size());
+    atomic<size_t> next(0);
+    vector<thread> pool;
+    for (unsigned w = 0; w < workers; w++) {
+        pool.emplace_back([&]() {
+            for (size_t j = next++; j < jobs.size(); j = next++) {
+                runJob(jobs[j], options);
+            }
+        });
+    }
+    for (thread& worker : pool) {
+        worker.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    for (const BatchJob& job : jobs) {
+        if (job.outputFile.empty()) {
+            cout << job.inputFile << " " << (job.forwarding ? "forward" : "noforward")
+                 << " stopped at a misaligned pc after " << job.cycles << " cycles" << endl;
+            continue;
+        }
+        ofstream outFile(job.outputFile);
+        if (!outFile) {
+            cerr << "Error opening file: " << job.outputFile << endl;
+            failures++;
+            continue;
+        }
+        outFile << job.diagram;
+        cout << job.inputFile << " " << (job.forwarding ? "forward" : "noforward")
+             << " " << job.cycles << " cycles -> " << job.outputFile << endl;
+    }
+    cout << jobs.size() << " runs on " << workers << " threads in " << seconds << " s" << endl;
+    return failures ? 1 : 0;
+}
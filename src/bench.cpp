@@ -0,0 +1,192 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <sys/resource.h>
+#include "Processor.hpp"
+using namespace std;
+
+// Throughput benchmark of the pipeline core. Every kernel runs to completion
+// (halt mode) under each forwarding policy, repeatedly until enough time has
+// been measured, and the simulated cycles and retired instructions per second
+// of wall-clock time are reported. A second, profiled pass splits the time
+// between the stages; it is kept apart so the timers do not slow the first.
+
+namespace {
+
+struct BenchOptions {
+    int maxCycles = 5000000;  // Cap of every run
+    double minSeconds = 0.5;  // Measured time per kernel and policy
+    bool forward = true;
+    bool noforward = true;
+    bool stages = true;       // Profiled pass
+    bool dataCacheEnabled = false;
+    CacheConfig dataCache;
+    bool instructionCacheEnabled = false;
+    CacheConfig instructionCache;
+    PredictorConfig predictor;
+    vector<string> inputFiles;
+};
+
+struct BenchResult {
+    int runs = 0;
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    double seconds = 0;
+};
+
+void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [options] <input_file>..." << endl;
+    cerr << "  --max-cycles N      cap of every run (default 5000000)" << endl;
+    cerr << "  --min-time S        seconds measured per kernel and policy (default 0.5)" << endl;
+    cerr << "  --modes M           forward, noforward or both (default both)" << endl;
+    cerr << "  --no-stages         skip the per-stage profile" << endl;
+    cerr << "  --dcache SPEC       simulate an L1 data cache (see forward --dcache)" << endl;
+    cerr << "  --icache SPEC       simulate an L1 instruction cache" << endl;
+    cerr << "  --predictor SPEC    branch predictor (see forward --predictor)" << endl;
+}
+
+bool parseBenchOptions(int argc, char* argv[], BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--max-cycles" && i + 1 < argc) {
+            options.maxCycles = atoi(argv[++i]);
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            options.minSeconds = atof(argv[++i]);
+        } else if (arg == "--modes" && i + 1 < argc) {
+            string modes = argv[++i];
+            options.forward = modes == "forward" || modes == "both";
+            options.noforward = modes == "noforward" || modes == "both";
+            if (!options.forward && !options.noforward) return false;
+        } else if (arg == "--no-stages") {
+            options.stages = false;
+        } else if (arg == "--dcache" && i + 1 < argc) {
+            options.dataCacheEnabled = true;
+            if (!CacheConfig::parse(argv[++i], options.dataCache)) return false;
+        } else if (arg == "--predictor" && i + 1 < argc) {
+            if (!PredictorConfig::parse(argv[++i], options.predictor)) return false;
+        } else if (arg == "--icache" && i + 1 < argc) {
+            options.instructionCacheEnabled = true;
+            if (!CacheConfig::parse(argv[++i], options.instructionCache)) return false;
+        } else if (arg.compare(0, 2, "--") == 0) {
+            return false;
+        } else {
+            options.inputFiles.push_back(arg);
+        }
+    }
+    return options.maxCycles > 0 && !options.inputFiles.empty();
+}
+
+// Peak resident set size of this process so far, in KiB
+long peakRSSKiB() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // Bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+// One complete run on a fresh processor; only simulate() is timed
+void runOnce(const string& inputFile, bool forwarding, const BenchOptions& options,
+             BenchResult& result, StageTimes* stageTimes) {
+    Processor processor(inputFile, 0);
+    processor.setForwardingEnabled(forwarding);
+    processor.setStageTimes(stageTimes);
+    if (options.dataCacheEnabled) {
+        processor.setDataCache(options.dataCache);
+    }
+    if (options.instructionCacheEnabled) {
+        processor.setInstructionCache(options.instructionCache);
+    }
+    processor.setBranchPredictor(options.predictor);
+    processor.reset(true);
+    auto start = chrono::steady_clock::now();
+    int cycles = processor.simulate(options.maxCycles, true);
+    result.seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    result.cycles += cycles;
+    result.instructions += processor.stats.retired;
+    result.runs++;
+}
+
+string kernelName(const string& inputFile) {
+    size_t slash = inputFile.find_last_of('/');
+    string name = slash == string::npos ? inputFile : inputFile.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    return dot == string::npos ? name : name.substr(0, dot);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!parseBenchOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    cout << left << setw(22) << "kernel" << setw(10) << "mode" << right
+         << setw(6) << "runs" << setw(10) << "cycles" << setw(10) << "instrs"
+         << setw(7) << "CPI" << setw(11) << "Mcycles/s" << setw(11) << "Minstrs/s";
+    if (options.stages) {
+        cout << "   hazards/WB/MEM/EX/ID/IF %";
+    }
+    cout << endl;
+
+    BenchResult total;
+    for (const string& inputFile : options.inputFiles) {
+        if (!ifstream(inputFile)) {
+            cerr << "Error: Could not open file " << inputFile << endl;
+            return 1;
+        }
+        for (int mode = 0; mode < 2; mode++) {
+            bool forwarding = mode == 0;
+            if (forwarding ? !options.forward : !options.noforward) continue;
+
+            BenchResult result;
+            do {
+                runOnce(inputFile, forwarding, options, result, nullptr);
+            } while (result.seconds < options.minSeconds);
+            total.runs += result.runs;
+            total.cycles += result.cycles;
+            total.instructions += result.instructions;
+            total.seconds += result.seconds;
+
+            cout << left << setw(22) << kernelName(inputFile) << setw(10)
+                 << (forwarding ? "forward" : "noforward") << right
+                 << setw(6) << result.runs << setw(10) << result.cycles / result.runs
+                 << setw(10) << result.instructions / result.runs << fixed << setprecision(2)
+                 << setw(7) << (result.instructions ? double(result.cycles) / result.instructions : 0.0)
+                 << setw(11) << result.cycles / result.seconds / 1e6
+                 << setw(11) << result.instructions / result.seconds / 1e6;
+
+            if (options.stages) {
+                // As many runs as the measured pass, with every stage timed
+                StageTimes times;
+                BenchResult profiled;
+                for (int run = 0; run < result.runs; run++) {
+                    runOnce(inputFile, forwarding, options, profiled, &times);
+                }
+                double stageSeconds = 0;
+                for (double seconds : times.seconds) {
+                    stageSeconds += seconds;
+                }
+                cout << "  ";
+                for (int part = 0; part < StageTimes::kParts; part++) {
+                    cout << (part ? "/" : " ") << setprecision(0)
+                         << (stageSeconds > 0 ? 100 * times.seconds[part] / stageSeconds : 0.0);
+                }
+            }
+            cout << defaultfloat << endl;
+        }
+    }
+
+    cout << "total: " << total.cycles << " cycles, " << total.instructions << " instructions in "
+         << fixed << setprecision(3) << total.seconds << " s ("
+         << setprecision(2) << total.cycles / total.seconds / 1e6 << " Mcycles/s, "
+         << total.instructions / total.seconds / 1e6 << " Minstrs/s), peak RSS "
+         << peakRSSKiB() << " KiB" << endl;
+    return 0;
+}
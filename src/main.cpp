@@ -0,0 +1,149 @@
+#include <iostream>
+#include "Harts.hpp"
+#include "Processor.hpp"
+using namespace std;
+
+// The forward and noforward binaries are built from the same sources and
+// only differ in the policy they use when neither --forward nor --no-forward
+// is given
+#ifndef DEFAULT_FORWARDING
+#define DEFAULT_FORWARDING 1
+#endif
+
+namespace {
+
+// --harts: every hart writes its own diagram and, with --stats, its counters
+// as one element of a JSON array
+int runHarts(const RunOptions& options) {
+    if (options.functional || options.fastForward > 0 || options.sampled || !options.restoreCheckpoint.empty() ||
+        !options.saveCheckpoint.empty() || !options.traceFile.empty()) {
+        cerr << "Error: --harts cannot be combined with functional execution, sampling, checkpoints or traces" << endl;
+        return 1;
+    }
+    HartGroup group(options.inputFile, options.harts);
+    for (uint32_t id = 0; id < group.size(); id++) {
+        Processor& hart = group.hart(id);
+        hart.setStreamWindow(PipelineStream::kDefaultWindow);
+        hart.setForwardingEnabled(options.forwarding);
+        if (options.dataCacheEnabled) {
+            hart.setDataCache(options.dataCache);
+        }
+        if (options.instructionCacheEnabled) {
+            hart.setInstructionCache(options.instructionCache);
+        }
+        hart.setBranchPredictor(options.predictor);
+        if (options.mulDivEnabled) {
+            hart.setMulDivUnit(options.mulDiv);
+        }
+        hart.setPipelineDepth(options.depth);
+        hart.setIssueWidth(options.width);
+    }
+    group.reset(options.untilHalt);
+    if (options.quantum > 0) {
+        group.runParallel(options.cycles, options.untilHalt, options.quantum);
+    } else {
+        group.runLockstep(options.cycles, options.untilHalt);
+    }
+    for (uint32_t id = 0; id < group.size(); id++) {
+        Processor& hart = group.hart(id);
+        if (!hart.fetchFault) {
+            hart.print_pipeline(hart.getCycle(), hart.isForwardingEnabled(), options.inputFile);
+        }
+    }
+    if (options.stats) {
+        cout << "[" << endl;
+        for (uint32_t id = 0; id < group.size(); id++) {
+            if (id > 0) cout << "," << endl;
+            group.hart(id).writeStats(cout);
+        }
+        cout << "]" << endl;
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    // Check command line arguments
+    RunOptions options;
+    options.forwarding = DEFAULT_FORWARDING;
+    if (!parseRunOptions(argc, argv, options)) {
+        return 1;
+    }
+    if (options.outOfOrderEnabled &&
+        (options.harts > 1 || options.sampled || options.width > 1 || options.depth != PipelineDepth() ||
+         !options.restoreCheckpoint.empty() || !options.saveCheckpoint.empty())) {
+        cerr << "Error: --ooo cannot be combined with --harts, --width, --depth, sampling or checkpoints" << endl;
+        return 1;
+    }
+    if (options.harts > 1) {
+        return runHarts(options);
+    }
+
+    // Create processor and run simulation; the diagram is rendered in windows
+    // while simulating, so memory does not grow with the number of cycles
+    Processor processor(options.inputFile, 0);
+    processor.setStreamWindow(PipelineStream::kDefaultWindow);
+    processor.setForwardingEnabled(options.forwarding);
+    if (options.dataCacheEnabled) {
+        processor.setDataCache(options.dataCache);
+    }
+    if (options.instructionCacheEnabled) {
+        processor.setInstructionCache(options.instructionCache);
+    }
+    processor.setBranchPredictor(options.predictor);
+    if (options.mulDivEnabled) {
+        processor.setMulDivUnit(options.mulDiv);
+    }
+    processor.setPipelineDepth(options.depth);
+    processor.setIssueWidth(options.width);
+    if (options.outOfOrderEnabled) {
+        processor.setOutOfOrder(options.outOfOrder);
+    }
+    processor.reset(options.untilHalt);
+    if (!options.restoreCheckpoint.empty() && !processor.restoreCheckpoint(options.restoreCheckpoint)) {
+        return 1;
+    }
+    if ((options.functional || options.fastForward > 0 || options.sampled) && !processor.isPipelineEmpty()) {
+        // Functional steps start at pc and would skip the instructions in flight
+        cerr << "Error: functional execution needs a checkpoint taken with an empty pipeline" << endl;
+        return 1;
+    }
+    if (options.functional) {
+        uint64_t executed = processor.runFunctional(options.cycles);
+        cout << "Instructions: " << executed << endl;
+        processor.printRegisters(cout);
+        if (!options.saveCheckpoint.empty() && !processor.saveCheckpoint(options.saveCheckpoint)) {
+            return 1;
+        }
+        return 0;
+    }
+    if (options.fastForward > 0) {
+        processor.runFunctional(options.fastForward);
+    }
+    if (!options.traceFile.empty() && !processor.startInstructionTrace(options.traceFile)) {
+        return 1;
+    }
+    if (options.sampled) {
+        SamplingResult result = processor.runSampled(options.sampling, options.cycles);
+        processor.writeSampledStats(cout, options.sampling, result);
+        if (!processor.finishInstructionTrace()) {
+            return 1;
+        }
+        if (!options.saveCheckpoint.empty() && !processor.saveCheckpoint(options.saveCheckpoint)) {
+            return 1;
+        }
+        return 0;
+    }
+    processor.run(options.cycles, options.inputFile, options.untilHalt);
+    if (!processor.finishInstructionTrace()) {
+        return 1;
+    }
+    if (options.stats) {
+        processor.writeStats(cout);
+    }
+    if (!options.saveCheckpoint.empty() && !processor.saveCheckpoint(options.saveCheckpoint)) {
+        return 1;
+    }
+    return 0;
+}
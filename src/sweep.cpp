@@ -0,0 +1,369 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "Processor.hpp"
+using namespace std;
+
+// Design-space sweep: runs every program over the cartesian product of the
+// forwarding policies, data caches, instruction caches, predictors,
+// multiplier/divider latencies, pipeline depths and issue widths given, one
+// row of counters per point. Every program is loaded and decoded once and the
+// decoded image is shared read-only by all the processors that run it; the
+// points are spread over a pool of worker threads and the rows are written
+// in grid order once every run has finished.
+
+namespace {
+
+// One value of a cache axis: no cache, or a cache with this configuration
+struct CacheChoice {
+    bool enabled = false;
+    CacheConfig config;
+
+    string describe() const { return enabled ? config.describe() : "none"; }
+};
+
+// One value of the multiplier/divider axis: single-cycle, or this unit
+struct MulDivChoice {
+    bool enabled = false;
+    MulDivConfig config;
+
+    string describe() const { return enabled ? config.describe() : "none"; }
+};
+
+struct SweepOptions {
+    int cycles = 0;
+    bool untilHalt = false;
+    vector<bool> modes = {true, false}; // Forwarding policies, forward first
+    vector<CacheChoice> dataCaches = {CacheChoice()};
+    vector<CacheChoice> instructionCaches = {CacheChoice()};
+    vector<PredictorConfig> predictors = {PredictorConfig()};
+    vector<MulDivChoice> mulDivs = {MulDivChoice()};
+    vector<PipelineDepth> depths = {PipelineDepth()};
+    vector<uint32_t> widths = {1}; // Issue widths
+    unsigned jobs = 0;   // 0: one worker per hardware thread
+    bool json = false;   // JSON array instead of CSV
+    string outputFile;   // Standard output if empty
+    vector<string> inputFiles;
+};
+
+// One point of the grid and what its run measured
+struct SweepPoint {
+    size_t program = 0;  // Index in SweepOptions::inputFiles
+    bool forwarding = true;
+    const CacheChoice* dataCache = nullptr;
+    const CacheChoice* instructionCache = nullptr;
+    const PredictorConfig* predictor = nullptr;
+    const MulDivChoice* mulDiv = nullptr;
+    const PipelineDepth* depth = nullptr;
+    uint32_t width = 1;
+    bool halted = false; // The program finished within the cycles
+    PipelineStats stats;
+};
+
+void printUsage(const char* program) {
+    cerr << "Usage: " << program << " <cycle_count|halt> [options] <input_file>..." << endl;
+    cerr << "  --max-cycles N      cap for halt mode (default " << Processor::kDefaultMaxCycles << ")" << endl;
+    cerr << "  --modes M           forward, noforward or both (default both)" << endl;
+    cerr << "  --dcache LIST       data caches to try, comma-separated SPECs (see forward --dcache)" << endl;
+    cerr << "                      or none (default none)" << endl;
+    cerr << "  --icache LIST       instruction caches to try, likewise" << endl;
+    cerr << "  --predictor LIST    predictors to try, comma-separated SPECs (see forward" << endl;
+    cerr << "                      --predictor) or none (default none)" << endl;
+    cerr << "  --muldiv LIST       multiplier/divider latencies to try, comma-separated SPECs" << endl;
+    cerr << "                      (see forward --muldiv) or none (default none)" << endl;
+    cerr << "  --depth LIST        pipeline depths to try, comma-separated SPECs (see forward" << endl;
+    cerr << "                      --depth; default 1:1:1)" << endl;
+    cerr << "  --width LIST        issue widths to try, comma-separated (see forward --width;" << endl;
+    cerr << "                      default 1)" << endl;
+    cerr << "  --jobs N            worker threads (default: hardware threads)" << endl;
+    cerr << "  --format F          csv or json (default csv)" << endl;
+    cerr << "  -o FILE             write the rows to FILE instead of the standard output" << endl;
+}
+
+vector<string> splitList(const string& list) {
+    vector<string> items;
+    istringstream in(list);
+    string item;
+    while (getline(in, item, ',')) {
+        items.push_back(item);
+    }
+    return items;
+}
+
+bool parseCacheList(const string& list, vector<CacheChoice>& choices) {
+    choices.clear();
+    for (const string& spec : splitList(list)) {
+        CacheChoice choice;
+        if (spec != "none") {
+            choice.enabled = true;
+            if (!CacheConfig::parse(spec, choice.config)) return false;
+        }
+        choices.push_back(choice);
+    }
+    return !choices.empty();
+}
+
+bool parsePredictorList(const string& list, vector<PredictorConfig>& predictors) {
+    predictors.clear();
+    for (const string& spec : splitList(list)) {
+        PredictorConfig config;
+        if (spec != "none" && !PredictorConfig::parse(spec, config)) return false;
+        predictors.push_back(config);
+    }
+    return !predictors.empty();
+}
+
+bool parseMulDivList(const string& list, vector<MulDivChoice>& choices) {
+    choices.clear();
+    for (const string& spec : splitList(list)) {
+        MulDivChoice choice;
+        if (spec != "none") {
+            choice.enabled = true;
+            if (!MulDivConfig::parse(spec, choice.config)) return false;
+        }
+        choices.push_back(choice);
+    }
+    return !choices.empty();
+}
+
+bool parseDepthList(const string& list, vector<PipelineDepth>& depths) {
+    depths.clear();
+    for (const string& spec : splitList(list)) {
+        PipelineDepth depth;
+        if (!PipelineDepth::parse(spec, depth)) return false;
+        depths.push_back(depth);
+    }
+    return !depths.empty();
+}
+
+bool parseWidthList(const string& list, vector<uint32_t>& widths) {
+    widths.clear();
+    for (const string& spec : splitList(list)) {
+        int width = atoi(spec.c_str());
+        if (width <= 0 || width > static_cast<int>(PipelineStats::kMaxIssueWidth)) return false;
+        widths.push_back(width);
+    }
+    return !widths.empty();
+}
+
+bool parseSweepOptions(int argc, char* argv[], SweepOptions& options) {
+    if (argc < 3) return false;
+    int maxCycles = Processor::kDefaultMaxCycles;
+    string cycles = argv[1];
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--max-cycles" && i + 1 < argc) {
+            maxCycles = atoi(argv[++i]);
+        } else if (arg == "--modes" && i + 1 < argc) {
+            string modes = argv[++i];
+            options.modes.clear();
+            if (modes == "forward" || modes == "both") options.modes.push_back(true);
+            if (modes == "noforward" || modes == "both") options.modes.push_back(false);
+            if (options.modes.empty()) return false;
+        } else if (arg == "--dcache" && i + 1 < argc) {
+            if (!parseCacheList(argv[++i], options.dataCaches)) return false;
+        } else if (arg == "--icache" && i + 1 < argc) {
+            if (!parseCacheList(argv[++i], options.instructionCaches)) return false;
+        } else if (arg == "--predictor" && i + 1 < argc) {
+            if (!parsePredictorList(argv[++i], options.predictors)) return false;
+        } else if (arg == "--muldiv" && i + 1 < argc) {
+            if (!parseMulDivList(argv[++i], options.mulDivs)) return false;
+        } else if (arg == "--depth" && i + 1 < argc) {
+            if (!parseDepthList(argv[++i], options.depths)) return false;
+        } else if (arg == "--width" && i + 1 < argc) {
+            if (!parseWidthList(argv[++i], options.widths)) return false;
+        } else if (arg == "--jobs" && i + 1 < argc) {
+            options.jobs = atoi(argv[++i]);
+        } else if (arg == "--format" && i + 1 < argc) {
+            string format = argv[++i];
+            if (format != "csv" && format != "json") return false;
+            options.json = format == "json";
+        } else if (arg == "-o" && i + 1 < argc) {
+            options.outputFile = argv[++i];
+        } else if (arg.compare(0, 1, "-") == 0) {
+            return false;
+        } else {
+            options.inputFiles.push_back(arg);
+        }
+    }
+    options.untilHalt = cycles == "halt";
+    options.cycles = options.untilHalt ? maxCycles : atoi(cycles.c_str());
+    return options.cycles > 0 && !options.inputFiles.empty();
+}
+
+void runPoint(SweepPoint& point, const shared_ptr<const DecodedProgram>& program, const SweepOptions& options) {
+    Processor processor(program, 0);
+    processor.setForwardingEnabled(point.forwarding);
+    if (point.dataCache->enabled) {
+        processor.setDataCache(point.dataCache->config);
+    }
+    if (point.instructionCache->enabled) {
+        processor.setInstructionCache(point.instructionCache->config);
+    }
+    processor.setBranchPredictor(*point.predictor);
+    if (point.mulDiv->enabled) {
+        processor.setMulDivUnit(point.mulDiv->config);
+    }
+    processor.setPipelineDepth(*point.depth);
+    processor.setIssueWidth(point.width);
+    processor.reset(options.untilHalt);
+    // Only the counters are wanted: the diagram is dropped after every slice
+    // so that memory does not grow with the length of the run
+    const int slice = PipelineStream::kDefaultWindow;
+    for (int ran = 0; ran < options.cycles;) {
+        int cycles = min(slice, options.cycles - ran);
+        int stepped = processor.step(cycles, options.untilHalt);
+        processor.pipelineTrace.clear(processor.getCycle());
+        ran += stepped;
+        if (stepped < cycles || processor.fetchFault) break;
+    }
+    point.halted = processor.isHalted();
+    point.stats = processor.stats;
+    point.stats.stallsByRow.clear();
+}
+
+string programName(const string& inputFile) {
+    size_t slash = inputFile.find_last_of("/\\");
+    return slash == string::npos ? inputFile : inputFile.substr(slash + 1);
+}
+
+void writeCSV(ostream& out, const vector<SweepPoint>& points, const SweepOptions& options) {
+    out << "program,forwarding,dcache,icache,predictor,muldiv,depth,width,halted,cycles,retired,cpi,flushes,mispredictions,"
+        << "dcache_stalls,icache_stalls,stalls";
+    for (int type = 1; type < PipelineStats::kHazardTypes; type++) {
+        out << "," << hazardName(static_cast<HazardType>(type));
+    }
+    out << "\n";
+    for (const SweepPoint& point : points) {
+        const PipelineStats& stats = point.stats;
+        out << programName(options.inputFiles[point.program]) << "," << (point.forwarding ? "forward" : "noforward")
+            << "," << point.dataCache->describe() << "," << point.instructionCache->describe()
+            << "," << point.predictor->describe() << "," << point.mulDiv->describe() << "," << point.depth->describe()
+            << "," << point.width << "," << (point.halted ? 1 : 0)
+            << "," << stats.cycles << "," << stats.retired
+            << "," << (stats.retired ? double(stats.cycles) / stats.retired : 0.0)
+            << "," << stats.flushes << "," << stats.mispredictions
+            << "," << stats.memoryStalls << "," << stats.fetchStalls << "," << stats.totalStalls();
+        for (int type = 1; type < PipelineStats::kHazardTypes; type++) {
+            out << "," << stats.stalls[type];
+        }
+        out << "\n";
+    }
+}
+
+void writeJSON(ostream& out, const vector<SweepPoint>& points, const SweepOptions& options) {
+    out << "[";
+    const char* separator = "\n";
+    for (const SweepPoint& point : points) {
+        const PipelineStats& stats = point.stats;
+        out << separator << "  {\"program\": \"" << programName(options.inputFiles[point.program])
+            << "\", \"forwarding\": " << (point.forwarding ? "true" : "false")
+            << ", \"dcache\": \"" << point.dataCache->describe()
+            << "\", \"icache\": \"" << point.instructionCache->describe()
+            << "\", \"predictor\": \"" << point.predictor->describe()
+            << "\", \"muldiv\": \"" << point.mulDiv->describe()
+            << "\", \"depth\": \"" << point.depth->describe()
+            << "\", \"width\": " << point.width
+            << ", \"halted\": " << (point.halted ? "true" : "false")
+            << ", \"cycles\": " << stats.cycles << ", \"retired\": " << stats.retired
+            << ", \"cpi\": " << (stats.retired ? double(stats.cycles) / stats.retired : 0.0)
+            << ", \"flushes\": " << stats.flushes << ", \"mispredictions\": " << stats.mispredictions
+            << ", \"dcache_stalls\": " << stats.memoryStalls << ", \"icache_stalls\": " << stats.fetchStalls
+            << ", \"stalls\": {\"total\": " << stats.totalStalls();
+        for (int type = 1; type < PipelineStats::kHazardTypes; type++) {
+            out << ", \"" << hazardName(static_cast<HazardType>(type)) << "\": " << stats.stalls[type];
+        }
+        out << "}}";
+        separator = ",\n";
+    }
+    out << "\n]\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    SweepOptions options;
+    if (!parseSweepOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    vector<shared_ptr<const DecodedProgram>> programs;
+    for (const string& inputFile : options.inputFiles) {
+        string error;
+        programs.push_back(DecodedProgram::load(inputFile, error));
+        if (!programs.back()) {
+            cerr << "Error: " << error << endl;
+            return 1;
+        }
+    }
+
+    // Grid order: program, then policy, data cache, instruction cache, predictor, multiplier/divider, depth, width
+    vector<SweepPoint> points;
+    for (size_t program = 0; program < programs.size(); program++) {
+        for (bool forwarding : options.modes) {
+            for (const CacheChoice& dataCache : options.dataCaches) {
+                for (const CacheChoice& instructionCache : options.instructionCaches) {
+                    for (const PredictorConfig& predictor : options.predictors) {
+                        for (const MulDivChoice& mulDiv : options.mulDivs) {
+                            for (const PipelineDepth& depth : options.depths) {
+                                for (uint32_t width : options.widths) {
+                                    SweepPoint point;
+                                    point.program = program;
+                                    point.forwarding = forwarding;
+                                    point.dataCache = &dataCache;
+                                    point.instructionCache = &instructionCache;
+                                    point.predictor = &predictor;
+                                    point.mulDiv = &mulDiv;
+                                    point.depth = &depth;
+                                    point.width = width;
+                                    points.push_back(point);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    auto start = chrono::steady_clock::now();
+    unsigned workers = options.jobs ? options.jobs : max(1u, thread::hardware_concurrency());
+    workers = min<unsigned>(workers, points.size());
+    atomic<size_t> next(0);
+    vector<thread> pool;
+    for (unsigned w = 0; w < workers; w++) {
+        pool.emplace_back([&]() {
+            for (size_t p = next++; p < points.size(); p = next++) {
+                runPoint(points[p], programs[points[p].program], options);
+            }
+        });
+    }
+    for (thread& worker : pool) {
+        worker.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    ofstream file;
+    if (!options.outputFile.empty()) {
+        file.open(options.outputFile);
+        if (!file) {
+            cerr << "Error opening file: " << options.outputFile << endl;
+            return 1;
+        }
+    }
+    ostream& out = options.outputFile.empty() ? cout : file;
+    if (options.json) {
+        writeJSON(out, points, options);
+    } else {
+        writeCSV(out, points, options);
+    }
+    out.flush();
+    cerr << points.size() << " points on " << workers << " threads in " << seconds << " s" << endl;
+    return out ? 0 : 1;
+}
@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <climits>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Processor.hpp"
+using namespace std;
+
+// Reads a binary instruction trace (forward/noforward --trace) and writes
+// the text diagram print_pipeline produces for the same run, either whole or
+// for a range of cycles, or lists the records as CSV. Only the blocks that
+// touch the requested cycles are decoded, and the diagram is rendered with
+// the simulator's own PipelineTrace/PipelineStream, so memory stays bounded
+// by the rendering window rather than by the length of the trace.
+
+namespace {
+
+struct RenderOptions {
+    string traceFile;
+    string outputFile;  // Standard output if empty
+    bool ranged = false;
+    int firstCycle = 0; // Range [firstCycle, endCycle)
+    int endCycle = INT_MAX;
+    bool records = false;
+};
+
+void printUsage(const char* program) {
+    cerr << "Usage: " << program << " <trace_file> [options]" << endl;
+    cerr << "  --cycles A:B      only cycles A to B-1 (B may be left out: to the end)" << endl;
+    cerr << "  --records         one CSV line per dynamic instruction instead of the diagram" << endl;
+    cerr << "  -o FILE           write to FILE instead of the standard output" << endl;
+}
+
+bool parseRenderOptions(int argc, char* argv[], RenderOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--cycles" && i + 1 < argc) {
+            string range = argv[++i];
+            size_t colon = range.find(':');
+            if (colon == string::npos || colon == 0) return false;
+            try {
+                options.firstCycle = stoi(range.substr(0, colon));
+                if (colon + 1 < range.size()) options.endCycle = stoi(range.substr(colon + 1));
+            } catch (const exception&) {
+                return false;
+            }
+            if (options.firstCycle < 0 || options.endCycle <= options.firstCycle) return false;
+            options.ranged = true;
+        } else if (arg == "--records") {
+            options.records = true;
+        } else if (arg == "-o" && i + 1 < argc) {
+            options.outputFile = argv[++i];
+        } else if (arg.compare(0, 1, "-") == 0 || !options.traceFile.empty()) {
+            return false;
+        } else {
+            options.traceFile = arg;
+        }
+    }
+    return !options.traceFile.empty();
+}
+
+// One cell of the diagram to be marked
+struct Mark {
+    int cycle;
+    uint32_t row;
+    uint8_t stages;
+};
+
+bool renderDiagram(InstructionTraceReader& reader, const RenderOptions& options, ostream& out) {
+    const TraceHeader& header = reader.getHeader();
+    size_t rows = header.labels.size();
+    int begin = max(options.firstCycle, header.firstCycle);
+    int end = options.endCycle;
+    // The cycle before the range decides which cells of its first cycle are stall marks
+    int from = max(begin - 1, header.firstCycle);
+    PipelineTrace trace;
+    trace.clear(from);
+    PipelineStream stream(PipelineStream::kDefaultWindow);
+    bool skipped = from == begin;
+    int applied = from; // Every mark of the cycles before this is in the trace
+    vector<Mark> pending;
+
+    // Records come in fetch order, so once one has been fetched at `cycle`
+    // no later record touches an earlier cycle
+    auto applyBefore = [&](int cycle) {
+        cycle = min(cycle, end);
+        if (cycle <= applied) return;
+        auto done = stable_partition(pending.begin(), pending.end(), [&](const Mark& mark) { return mark.cycle < cycle; });
+        stable_sort(pending.begin(), done, [](const Mark& a, const Mark& b) { return a.cycle < b.cycle; });
+        for (auto mark = pending.begin(); mark != done; ++mark) {
+            trace.mark(mark->row, mark->cycle, mark->stages);
+        }
+        pending.erase(pending.begin(), done);
+        applied = cycle;
+        if (!skipped && applied >= begin) {
+            stream.skip(trace, rows, begin);
+            skipped = true;
+        }
+        if (skipped && applied - trace.firstCycle() >= stream.getWindow()) {
+            stream.flush(trace, rows, applied);
+        }
+    };
+
+    uint32_t count;
+    int32_t blockFirst, blockLast;
+    vector<InstructionRecord> records;
+    while (reader.nextBlock(count, blockFirst, blockLast)) {
+        if (blockLast < from || blockFirst >= end) {
+            if (!reader.skipRecords()) break;
+            continue;
+        }
+        if (!reader.readRecords(records)) break;
+        for (const InstructionRecord& record : records) {
+            if (record.first[InstructionRecord::IF] >= 0) {
+                applyBefore(record.first[InstructionRecord::IF]);
+            }
+            uint32_t row = (record.pc - header.textBase) / 4;
+            if (row >= rows) continue;
+            for (int stage = 0; stage < InstructionRecord::kStages; stage++) {
+                for (uint32_t k = 0; k < record.cycles[stage]; k++) {
+                    int cycle = record.first[stage] + k;
+                    if (cycle >= applied && cycle < end) {
+                        pending.push_back({cycle, row, record.stageBits(stage, k)});
+                    }
+                }
+            }
+        }
+    }
+    if (!reader.atEnd()) {
+        cerr << "Error: " << options.traceFile << " is truncated or corrupt" << endl;
+        return false;
+    }
+    int last = min(end, reader.getEndCycle());
+    if (last <= begin) {
+        cerr << "Error: the trace covers cycles " << header.firstCycle << " to " << reader.getEndCycle() - 1 << endl;
+        return false;
+    }
+    end = last;
+    applyBefore(last);
+    writeCycleHeader(out, begin, last);
+    stream.finish(out, trace, header.labels, last);
+    return true;
+}
+
+// CSV field of a diagram label
+string csvField(const string& text) {
+    if (text.find_first_of(",\"") == string::npos) return text;
+    string quoted = "\"";
+    for (char c : text) {
+        if (c == '"') quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+bool listRecords(InstructionTraceReader& reader, const RenderOptions& options, ostream& out) {
+    const TraceHeader& header = reader.getHeader();
+    out << "pc,instruction,if,if_cycles,id,id_cycles,ex,ex_cycles,mem,mem_cycles,wb,wb_cycles,squashed,stall,stall_cycles\n";
+    uint32_t count;
+    int32_t blockFirst, blockLast;
+    vector<InstructionRecord> records;
+    while (reader.nextBlock(count, blockFirst, blockLast)) {
+        if (blockLast < options.firstCycle || blockFirst >= options.endCycle) {
+            if (!reader.skipRecords()) break;
+            continue;
+        }
+        if (!reader.readRecords(records)) break;
+        for (const InstructionRecord& record : records) {
+            int recordFirst = INT_MAX;
+            int recordLast = INT_MIN;
+            for (int stage = 0; stage < InstructionRecord::kStages; stage++) {
+                if (record.first[stage] < 0) continue;
+                recordFirst = min(recordFirst, record.first[stage]);
+                recordLast = max<int>(recordLast, record.first[stage] + record.cycles[stage] - 1);
+            }
+            if (recordLast < options.firstCycle || recordFirst >= options.endCycle) continue;
+            uint32_t row = (record.pc - header.textBase) / 4;
+            out << record.pc << "," << csvField(row < header.labels.size() ? header.labels[row].second : "");
+            for (int stage = 0; stage < InstructionRecord::kStages; stage++) {
+                out << ",";
+                if (record.first[stage] >= 0) out << record.first[stage];
+                out << "," << record.cycles[stage];
+            }
+            out << "," << (record.squashed ? 1 : 0) << ","
+                << (record.stallCycles ? hazardName(static_cast<HazardType>(record.stallCause)) : "")
+                << "," << record.stallCycles << "\n";
+        }
+    }
+    if (!reader.atEnd()) {
+        cerr << "Error: " << options.traceFile << " is truncated or corrupt" << endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    RenderOptions options;
+    if (!parseRenderOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    InstructionTraceReader reader;
+    string error;
+    if (!reader.open(options.traceFile, error)) {
+        cerr << "Error: " << error << endl;
+        return 1;
+    }
+    ofstream file;
+    if (!options.outputFile.empty()) {
+        file.open(options.outputFile);
+        if (!file) {
+            cerr << "Error opening file: " << options.outputFile << endl;
+            return 1;
+        }
+    }
+    ostream& out = options.outputFile.empty() ? cout : file;
+    bool rendered = options.records ? listRecords(reader, options, out) : renderDiagram(reader, options, out);
+    out.flush();
+    return rendered && out ? 0 : 1;
+}
@@ -5,7 +5,7 @@ import sys
 import glob
 import time
 
-def process_input_files(input_dir, src_dir, output_dir):
+def process_input_files(input_dir, src_dir, output_dir, cycles='50'):
     # Validate input directories exist
     if not os.path.exists(input_dir):
         print(f"Error: Input directory {input_dir} does not exist.")
@@ -18,6 +18,29 @@ def process_input_files(input_dir, src_dir, output_dir):
     # Create output directory if it doesn't exist
     os.makedirs(output_dir, exist_ok=True)
     
+    # Prefer the batch runner: one process simulates every program under both
+    # policies on all cores and writes the outputs at the end
+    batch_exe = os.path.join(src_dir, 'batch')
+    if os.path.exists(batch_exe):
+        inputs = sorted(os.path.join(input_dir, f) for f in os.listdir(input_dir) if f.endswith('.txt'))
+        # Clear previous output files, so that a program that writes no
+        # diagram this time does not leave an old one looking current
+        for input_file in inputs:
+            base_filename = os.path.splitext(os.path.basename(input_file))[0]
+            for old_file in glob.glob(f"{output_dir}/{base_filename}_*_out.txt"):
+                os.remove(old_file)
+        batch_output = subprocess.run(
+            [batch_exe, cycles, '--output-dir', output_dir] + inputs,
+            capture_output=True,
+            text=True,
+            cwd=src_dir
+        )
+        print(batch_output.stdout, end='')
+        if batch_output.returncode != 0:
+            print(f"Batch run failed: {batch_output.stderr}")
+            sys.exit(1)
+        return
+    
     # Path to executables
     forward_exe = os.path.join(src_dir, 'forward')
     noforward_exe = os.path.join(src_dir, 'noforward')
@@ -48,7 +71,7 @@ def process_input_files(input_dir, src_dir, output_dir):
                 env["OUTPUT_DIR"] = output_dir  # Pass output dir as environment variable
                 
                 forward_output = subprocess.run(
-                    [forward_exe, input_file_path, '50'], 
+                    [forward_exe, input_file_path, cycles], 
                     capture_output=True, 
                     text=True, 
                     env=env,
@@ -95,7 +118,7 @@ def process_input_files(input_dir, src_dir, output_dir):
                 env["OUTPUT_DIR"] = output_dir
                 
                 noforward_output = subprocess.run(
-                    [noforward_exe, input_file_path, '50'], 
+                    [noforward_exe, input_file_path, cycles], 
                     capture_output=True, 
                     text=True, 
                     env=env,
@@ -139,8 +162,10 @@ def main():
     input_dir = os.path.join(script_dir, 'inputfiles')
     src_dir = os.path.join(script_dir, 'src')
     output_dir = os.path.join(script_dir, 'outputfiles')
+    # Cycle count passed to the simulators; 'halt' runs each program to completion
+    cycles = sys.argv[1] if len(sys.argv) > 1 else '50'
     
-    process_input_files(input_dir, src_dir, output_dir)
+    process_input_files(input_dir, src_dir, output_dir, cycles)
 
 if __name__ == "__main__":
     main()